@@ -0,0 +1,351 @@
+/**************************************************
+# Copyright (C) 2014 Raptis Dimos <raptis.dimos@yahoo.gr>
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+# **************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <mpi.h>
+#include <sys/time.h>
+#include "utils.h"
+#include "mpi_utils.h"
+
+//Default block size
+#define NB 64
+
+#define MIN(a,b) ((a)<(b)?(a):(b))
+#define MAX(a,b) ((a)>(b)?(a):(b))
+
+//Number of the first n global rows (or columns) that process iproc of
+//nprocs owns when blocks of nb are dealt cyclically
+static int numroc(int n, int nb, int iproc, int nprocs) {
+    int nblocks=n/nb;
+    int num=(nblocks/nprocs)*nb;
+    int extra=nblocks%nprocs;
+    if (iproc<extra)
+        num+=nb;
+    else if (iproc==extra)
+        num+=n%nb;
+    return num;
+}
+
+//Global index of local index l on process iproc
+static int l2g(int l, int nb, int iproc, int nprocs) {
+    return ((l/nb)*nprocs+iproc)*nb+l%nb;
+}
+
+//Copy between the global matrix and the local matrix of process (pr,pc)
+static void pack_local(double ** A, double ** loc, int m, int n, int nb, int pr, int pc, int P, int Q, int to_local) {
+    int i,j,gi,gj;
+    for (i=0;i<m;i++) {
+        gi=l2g(i,nb,pr,P);
+        for (j=0;j<n;j++) {
+            gj=l2g(j,nb,pc,Q);
+            if (to_local)
+                loc[i][j]=A[gi][gj];
+            else
+                A[gi][gj]=loc[i][j];
+        }
+    }
+}
+
+//Random local matrix of this process, the entries of init2D at the global
+//positions of its blocks
+static void rand_local(double ** loc, int m, int n, int nb, int pr, int pc, int P, int Q) {
+    int i,j,gi;
+    for (i=0;i<m;i++) {
+        gi=l2g(i,nb,pr,P);
+        for (j=0;j<n;j++)
+            loc[i][j]=rand_entry(RAND_MATRIX,gi,l2g(j,nb,pc,Q));
+    }
+}
+
+//Read or write the local matrix of this process from or to a binary matrix
+//file, the file view selects the blocks of the process on the PxQ grid
+static void io_local(char * filename, double ** loc, int m, int n, int X, int Y, int nb, int P, int Q, int write) {
+    int rank,size;
+    int gsizes[2]={X,Y},distribs[2]={MPI_DISTRIBUTE_CYCLIC,MPI_DISTRIBUTE_CYCLIC},dargs[2]={nb,nb},psizes[2]={P,Q};
+    mat_header h;
+    MPI_File fh;
+    MPI_Datatype view;
+    MPI_Comm_size(MPI_COMM_WORLD,&size);
+    MPI_Comm_rank(MPI_COMM_WORLD,&rank);
+    if (MPI_File_open(MPI_COMM_WORLD,filename,write ? MPI_MODE_WRONLY|MPI_MODE_CREATE : MPI_MODE_RDONLY,MPI_INFO_NULL,&fh)!=MPI_SUCCESS) {
+        fprintf(stderr,"Cannot open %s!\n",filename);
+        MPI_Abort(MPI_COMM_WORLD,-1);
+    }
+    if (write) {
+        MPI_File_set_size(fh,0);
+        if (rank==0) {
+            init2DHeader(&h,X,Y);
+            MPI_File_write_at(fh,0,&h,sizeof(h),MPI_BYTE,MPI_STATUS_IGNORE);
+        }
+    }
+    MPI_Type_create_darray(size,rank,2,gsizes,distribs,dargs,psizes,MPI_ORDER_C,MPI_DOUBLE,&view);
+    MPI_Type_commit(&view);
+    MPI_File_set_view(fh,sizeof(mat_header),MPI_DOUBLE,view,"native",MPI_INFO_NULL);
+    if (write)
+        MPI_File_write_all(fh,&loc[0][0],m*n,MPI_DOUBLE,MPI_STATUS_IGNORE);
+    else
+        MPI_File_read_all(fh,&loc[0][0],m*n,MPI_DOUBLE,MPI_STATUS_IGNORE);
+    MPI_File_close(&fh);
+    MPI_Type_free(&view);
+}
+
+
+int main (int argc, char * argv[]) {
+    int rank,size;
+    MPI_Init(&argc,&argv);
+    MPI_Comm_size(MPI_COMM_WORLD,&size);
+    MPI_Comm_rank(MPI_COMM_WORLD,&rank);
+
+    int run,runs,X,Y,P,Q,nb,pr,pc,m,n,i,j,p,r,kb,K,Kend,w,prow,pcol,lK,lcK,lr0,lc0,mr,nr;
+    double ** A=NULL, ** localA, ** localA0=NULL, ** D, ** Lp, * Up;
+    X=input_size(argv[1]);
+    Y=X;
+    FILE * fp;
+    char * filename="output_2d_block_cyclic";
+    char * binname="output_2d_block_cyclic.bin";
+    MPI_Status status;
+
+    //Process grid PxQ and block size nb, P is picked near sqrt(size) if not given
+    if (argc>3) {
+        P=atoi(argv[2]);
+        Q=atoi(argv[3]);
+    }
+    else {
+        for (P=(int)sqrt((double)size);size%P!=0;P--);
+        Q=size/P;
+    }
+    nb=NB;
+    if (argc>4)
+        nb=atoi(argv[4]);
+    if (P*Q!=size || nb<1) {
+        if (rank==0)
+            fprintf(stderr,"Usage: %s N [P Q [nb]] with P*Q equal to the number of processes\n",argv[0]);
+        MPI_Finalize();
+        return 1;
+    }
+
+    //Process coordinates and row/column communicators
+    pr=rank/Q;
+    pc=rank%Q;
+    MPI_Comm row_comm,col_comm;
+    MPI_Comm_split(MPI_COMM_WORLD,pr,pc,&row_comm);
+    MPI_Comm_split(MPI_COMM_WORLD,pc,pr,&col_comm);
+
+    //Local dimensions m,n
+    m=numroc(X,nb,pr,P);
+    n=numroc(Y,nb,pc,Q);
+    localA=malloc2D(MAX(m,1),MAX(n,1));
+    D=malloc2D(nb,nb);
+    Lp=malloc2D(MAX(m,1),nb);
+    Up=(double *)malloc(nb*MAX(n,1)*sizeof(double));
+    if (Up==NULL) {
+        fprintf(stderr,"Malloc failed!\n");
+        exit(-1);
+    }
+
+    //Every process reads its own blocks of a matrix file or makes its own
+    //blocks of a random array. For text output the array is made on rank 0,
+    //which prints it and sends every process its blocks.
+    if (input_is_file(argv[1]) && output_mode()!=OUT_TEXT)
+        io_local(argv[1],localA,m,n,X,Y,nb,P,Q,0);
+    else if (output_mode()!=OUT_TEXT)
+        rand_local(localA,m,n,nb,pr,pc,P,Q);
+    else {
+        if (rank==0) {
+            A=malloc2D(X,Y);
+            input2D(A,X,Y,argv[1]);
+            if (output_mode()==OUT_TEXT) {
+                fp = fopen(filename,"w");
+                fprintf(fp,"\n****Initial Array****\n");
+                fclose(fp);
+                print2DFile(A,X,Y,filename);
+            }
+            for (r=1;r<size;r++) {
+                int rm=numroc(X,nb,r/Q,P),rn=numroc(Y,nb,r%Q,Q);
+                if (rm*rn==0)
+                    continue;
+                double ** tmp=malloc2D(rm,rn);
+                pack_local(A,tmp,rm,rn,nb,r/Q,r%Q,P,Q,1);
+                MPI_Send(&tmp[0][0],rm*rn,MPI_DOUBLE,r,55,MPI_COMM_WORLD);
+                free2D(tmp,rm,rn);
+            }
+            pack_local(A,localA,m,n,nb,pr,pc,P,Q,1);
+            free2D(A,X,Y);
+        }
+        else if (m*n>0)
+            MPI_Recv(&localA[0][0],m*n,MPI_DOUBLE,0,55,MPI_COMM_WORLD,&status);
+    }
+
+    //Keep the original blocks to restart benchmark runs
+    bench_t bench;
+    bench_init(&bench);
+    runs=bench_runs(&bench);
+    if (runs>1) {
+        localA0=malloc2D(MAX(m,1),MAX(n,1));
+        copy2D(localA0,localA,MAX(m,1),MAX(n,1));
+    }
+
+    //Timers
+    struct timeval ts,tf,time1,time2;
+    double total_time=0,computation_time=0,communication_time=0,run_time;
+
+    for (run=0;run<runs;run++) {
+        //Every benchmark run starts again from the original blocks
+        if (run>0)
+            copy2D(localA,localA0,MAX(m,1),MAX(n,1));
+        communication_time=0;
+        MPI_Barrier(MPI_COMM_WORLD);
+        gettimeofday(&ts,NULL);
+
+        for (kb=0;kb*nb<X-1;kb++) {
+            K=kb*nb;
+            MPI_Pcontrol(TRACE_STEP,K);
+            Kend=MIN(K+nb,X);
+            w=Kend-K;
+            prow=kb%P;
+            pcol=kb%Q;
+            //Local offset of the diagonal block and of the trailing rows/columns
+            lK=numroc(K,nb,prow,P);
+            lcK=numroc(K,nb,pcol,Q);
+            lr0=numroc(Kend,nb,pr,P);
+            lc0=numroc(Kend,nb,pc,Q);
+            mr=m-lr0;
+            nr=n-lc0;
+
+            //Factor the diagonal block
+            if (pr==prow && pc==pcol) {
+                for (p=0;p<w;p++)
+                    for (i=p+1;i<w;i++)
+                        eliminate_row(&localA[lK+i][lcK],&localA[lK+p][lcK],p,w);
+                for (i=0;i<w;i++)
+                    for (j=0;j<w;j++)
+                        D[i][j]=localA[lK+i][lcK+j];
+            }
+
+            //Diagonal block down the panel column and along the pivot row
+            gettimeofday(&time1,NULL);
+            if (pc==pcol)
+                MPI_Bcast(&D[0][0],nb*nb,MPI_DOUBLE,prow,col_comm);
+            if (pr==prow)
+                MPI_Bcast(&D[0][0],nb*nb,MPI_DOUBLE,pcol,row_comm);
+            gettimeofday(&time2,NULL);
+            communication_time+=time2.tv_sec-time1.tv_sec+(time2.tv_usec-time1.tv_usec)*0.000001;
+
+            //Panel L21 = A21 * U11^-1
+            if (pc==pcol) {
+                for (i=lr0;i<m;i++)
+                    for (p=0;p<w;p++)
+                        eliminate_row(&localA[i][lcK],D[p],p,w);
+                for (i=0;i<mr;i++)
+                    for (p=0;p<w;p++)
+                        Lp[i][p]=localA[lr0+i][lcK+p];
+            }
+
+            //Block row U12 = L11^-1 * A12
+            if (pr==prow) {
+                for (p=0;p<w;p++)
+                    for (i=p+1;i<w;i++)
+                        axpy_row(&localA[lK+i][lc0],&localA[lK+p][lc0],D[i][p],nr);
+                for (p=0;p<w;p++)
+                    for (j=0;j<nr;j++)
+                        Up[p*nr+j]=localA[lK+p][lc0+j];
+            }
+
+            //Panel along the process rows, block row along the process columns
+            gettimeofday(&time1,NULL);
+            if (mr>0)
+                MPI_Bcast(&Lp[0][0],mr*nb,MPI_DOUBLE,pcol,row_comm);
+            if (nr>0)
+                MPI_Bcast(Up,nb*nr,MPI_DOUBLE,prow,col_comm);
+            gettimeofday(&time2,NULL);
+            communication_time+=time2.tv_sec-time1.tv_sec+(time2.tv_usec-time1.tv_usec)*0.000001;
+
+            //Trailing update A22 -= L21 * U12
+            for (i=0;i<mr;i++)
+                for (p=0;p<w;p++)
+                    axpy_row(&localA[lr0+i][lc0],&Up[p*nr],Lp[i][p],nr);
+        }
+
+        MPI_Pcontrol(TRACE_STEP,-1);
+        gettimeofday(&tf,NULL);
+        total_time=tf.tv_sec-ts.tv_sec+(tf.tv_usec-ts.tv_usec)*0.000001;
+        computation_time=total_time-communication_time;
+        MPI_Reduce(&total_time,&run_time,1,MPI_DOUBLE,MPI_MAX,0,MPI_COMM_WORLD);
+        bench_time(&bench,run,run_time);
+    }
+
+    //Gather local matrices back to the global matrix, only text output needs it
+    if (output_mode()==OUT_TEXT) {
+        if (rank==0) {
+            A=malloc2D(X,Y);
+            pack_local(A,localA,m,n,nb,pr,pc,P,Q,0);
+            for (r=1;r<size;r++) {
+                int rm=numroc(X,nb,r/Q,P),rn=numroc(Y,nb,r%Q,Q);
+                if (rm*rn==0)
+                    continue;
+                double ** tmp=malloc2D(rm,rn);
+                MPI_Recv(&tmp[0][0],rm*rn,MPI_DOUBLE,r,56,MPI_COMM_WORLD,&status);
+                pack_local(A,tmp,rm,rn,nb,r/Q,r%Q,P,Q,0);
+                free2D(tmp,rm,rn);
+            }
+        }
+        else if (m*n>0)
+            MPI_Send(&localA[0][0],m*n,MPI_DOUBLE,0,56,MPI_COMM_WORLD);
+    }
+
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    double avg_total,avg_comp,avg_comm,max_total,max_comp,max_comm;
+    MPI_Reduce(&total_time,&max_total,1,MPI_DOUBLE,MPI_MAX,0,MPI_COMM_WORLD);
+    MPI_Reduce(&computation_time,&max_comp,1,MPI_DOUBLE,MPI_MAX,0,MPI_COMM_WORLD);
+    MPI_Reduce(&communication_time,&max_comm,1,MPI_DOUBLE,MPI_MAX,0,MPI_COMM_WORLD);
+    MPI_Reduce(&total_time,&avg_total,1,MPI_DOUBLE,MPI_SUM,0,MPI_COMM_WORLD);
+    MPI_Reduce(&computation_time,&avg_comp,1,MPI_DOUBLE,MPI_SUM,0,MPI_COMM_WORLD);
+    MPI_Reduce(&communication_time,&avg_comm,1,MPI_DOUBLE,MPI_SUM,0,MPI_COMM_WORLD);
+
+    avg_total/=size;
+    avg_comp/=size;
+    avg_comm/=size;
+    if (rank==0) {
+        printf("LU-2D-Block-cyclic\tArray Size\t%d\tProcesses\t%d\tGrid\t%dx%d\tBlock\t%d\n",X,size,P,Q,nb);
+        printf("Max time:\tTotal\t%lf\tComputation\t%lf\tCommunication\t%lf\n",max_total,max_comp,max_comm);
+        printf("Avg time:\tTotal\t%lf\tComputation\t%lf\tCommunication\t%lf\n",avg_total,avg_comp,avg_comm);
+        bench_report(&bench,"LU-2D-Block-cyclic",X,size,1);
+    }
+
+    //Print triangular matrix U to file
+    if (output_mode()==OUT_BINARY)
+        io_local(binname,localA,m,n,X,Y,nb,P,Q,1);
+    else if (rank==0 && output_mode()==OUT_TEXT) {
+        fp = fopen(filename,"a");
+        fprintf(fp,"\n****Final Array****\n");
+        fclose(fp);
+        print2DFile(A,X,Y,filename);
+        free2D(A,X,Y);
+    }
+
+    if (localA0!=NULL)
+        free2D(localA0,MAX(m,1),MAX(n,1));
+    free2D(localA,MAX(m,1),MAX(n,1));
+    free2D(D,nb,nb);
+    free2D(Lp,MAX(m,1),nb);
+    free(Up);
+    MPI_Comm_free(&row_comm);
+    MPI_Comm_free(&col_comm);
+    MPI_Finalize();
+
+    return 0;
+}
@@ -0,0 +1,151 @@
+/**************************************************
+# Copyright (C) 2014 Raptis Dimos <raptis.dimos@yahoo.gr>
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+# **************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include "utils.h"
+#include "band.h"
+
+//LU of a random band matrix in band storage, O(N*kl*ku) work and
+//O(N*(kl+ku)) memory. Built once as lu_band and once with openMP as
+//lu_omp_band, where the rows are pipelined: every thread factors blocks of
+//at least kl consecutive rows (round robin), so a row only waits for another
+//thread on the first rows of a block, and eliminates with each of the kl rows
+//above as soon as that row is finished.
+#ifdef _OPENMP
+#include <omp.h>
+#include <sched.h>
+#endif
+
+//Fewest rows per block of the pipeline, and the spins on a row of another
+//thread before giving the core away
+#define BAND_BLOCK 64
+#define SPIN 1000
+
+#define MIN(a,b) ((a)<(b)?(a):(b))
+
+
+int main(int argc, char * argv[])
+{
+    if (argc<3) {
+        fprintf(stderr,"Usage: %s N kl [ku]\n",argv[0]);
+        exit(-1);
+    }
+    int N=atoi(argv[1]);
+    int kl=atoi(argv[2]);
+    int ku=kl;
+    if (argc>3)
+        ku=atoi(argv[3]);
+    if (N<1 || kl<0 || ku<0 || kl>=N || ku>=N) {
+        fprintf(stderr,"Usage: %s N kl [ku], 0<=kl,ku<N\n",argv[0]);
+        exit(-1);
+    }
+    int W=BAND_WIDTH(kl,ku);
+    int threads=1;
+    double ** A=malloc2D(N,W);
+    init2DBand(A,0,N,N,kl,ku);
+    struct timeval ts,tf;
+    double total_time=0,max[3];
+#ifdef _OPENMP
+    char * name="LU-OpenMP-Band", * filename="output_omp_band";
+    threads=omp_get_max_threads();
+    int i,d,rows=kl>BAND_BLOCK ? kl : BAND_BLOCK;
+    //Rows finished so far, set once a row is factored
+    int * done=malloc(N*sizeof(int));
+    if (done==NULL) {
+        fprintf(stderr,"Malloc failed!\n");
+        exit(-1);
+    }
+#else
+    char * name="LU-Band", * filename="output_band";
+#endif
+
+    //Keep a copy of A to check the solve stage and to restart benchmark runs
+    int nrhs=env_int("NRHS",0);
+    bench_t bench;
+    bench_init(&bench);
+    int run,runs=bench_runs(&bench);
+    double ** A0=NULL, ** B, ** B0;
+    if (nrhs>0 || runs>1) {
+        A0=malloc2D(N,W);
+        copy2D(A0,A,N,W);
+    }
+
+    for (run=0;run<runs;run++) {
+        //Every benchmark run starts again from the original band
+        if (run>0)
+            copy2D(A,A0,N,W);
+        gettimeofday(&ts,NULL);
+#ifdef _OPENMP
+        for (i=0;i<N;i++)
+            done[i]=0;
+        #pragma omp parallel for private(d) schedule(static,rows)
+        for (i=0;i<N;i++) {
+            int ready,spins;
+            for (d=MIN(kl,i);d>0;d--) {
+                //Rows of the same block are finished by this thread already
+                if (i%rows>=d) {
+                    eliminate_band(A[i],A[i-d],d,kl,ku);
+                    continue;
+                }
+                for (spins=0;;spins++) {
+                    #pragma omp atomic read seq_cst
+                    ready=done[i-d];
+                    if (ready)
+                        break;
+                    if (spins>=SPIN)
+                        sched_yield();
+                }
+                eliminate_band(A[i],A[i-d],d,kl,ku);
+            }
+            #pragma omp atomic write seq_cst
+            done[i]=1;
+        }
+#else
+        lu_band_rows(A,0,N,N,kl,ku);
+#endif
+        gettimeofday(&tf,NULL);
+        total_time=(tf.tv_sec-ts.tv_sec)+(tf.tv_usec-ts.tv_usec)*0.000001;
+        bench_time(&bench,run,total_time);
+    }
+    printf("%s\t%d\t%d\t%d\t%.3lf\n",name,N,kl,ku,total_time);
+    bench_report_flops(&bench,name,N,1,threads,(double)N*kl*(2*ku+1));
+
+    output2D(A,N,W,filename);
+
+    //Solve for a batch of NRHS right-hand sides with the factors
+    if (nrhs>0) {
+        B=malloc2D(N,nrhs);
+        B0=malloc2D(N,nrhs);
+        init2DRHS(B,N,nrhs);
+        copy2D(B0,B,N,nrhs);
+        gettimeofday(&ts,NULL);
+        forward_band(A,B,0,N,N,kl,nrhs);
+        backward_band(A,B,0,N,N,kl,ku,nrhs);
+        gettimeofday(&tf,NULL);
+        total_time=(tf.tv_sec-ts.tv_sec)+(tf.tv_usec-ts.tv_usec)*0.000001;
+        residual_band(A0,B,B0,0,N,N,kl,ku,nrhs,max);
+        printf("%s-Solve\t%d\t%d\t%.3lf\tResidual\t%e\n",name,N,nrhs,total_time,max[0]/(max[1]*max[2]*N));
+        free2D(B,N,nrhs);
+        free2D(B0,N,nrhs);
+    }
+    if (A0!=NULL)
+        free2D(A0,N,W);
+    free2D(A,N,W);
+#ifdef _OPENMP
+    free(done);
+#endif
+	return 0;
+}
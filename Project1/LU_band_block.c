@@ -0,0 +1,194 @@
+/**************************************************
+# Copyright (C) 2014 Raptis Dimos <raptis.dimos@yahoo.gr>
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+# **************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <mpi.h>
+#include "utils.h"
+#include "mpi_utils.h"
+#include "band.h"
+
+//Band LU with the rows of the band distributed in blocks. The first rows
+//of a process are eliminated with the last kl rows of the previous one, so
+//each process receives those kl factored rows as a halo, factors its own
+//rows and passes its last kl rows on. Without pivoting row i needs row
+//i-1 finished, so the processes factor one after the other: the
+//distribution spreads the O(N*(kl+ku)) memory, only halos of kl rows are
+//exchanged and no process holds the whole band.
+
+#define TAG_HALO 11
+
+
+int main(int argc, char * argv[])
+{
+    int rank,size;
+    MPI_Init(&argc,&argv);
+    MPI_Comm_size(MPI_COMM_WORLD,&size);
+    MPI_Comm_rank(MPI_COMM_WORLD,&rank);
+
+    if (argc<3) {
+        if (rank==0)
+            fprintf(stderr,"Usage: %s N kl [ku]\n",argv[0]);
+        MPI_Abort(MPI_COMM_WORLD,-1);
+    }
+    int N=atoi(argv[1]);
+    int kl=atoi(argv[2]);
+    int ku=kl;
+    if (argc>3)
+        ku=atoi(argv[3]);
+    int W=BAND_WIDTH(kl,ku);
+    int x;
+    double max[3],gmax[3];
+
+    //Local rows, the last ranks hold ghost rows if N%size!=0
+    x=(N+size-1)/size;
+    //Halos only come from the neighbours
+    if (N<1 || kl<0 || ku<0 || kl>x || ku>x) {
+        if (rank==0)
+            fprintf(stderr,"Usage: %s N kl [ku], 0<=kl,ku<=N/processes\n",argv[0]);
+        MPI_Abort(MPI_COMM_WORLD,-1);
+    }
+    int g0=rank*x;
+    char * filename="output_band_block";
+
+    //Local rows after kl halo rows, localA[i] is global row g0+i
+    //Every rank makes its own rows of the random band
+    double ** halo=malloc2D(kl+x,W), ** localA=&halo[kl];
+    init2DBand(localA,g0,g0<N ? (g0+x<N ? x : N-g0) : 0,N,kl,ku);
+
+    //Keep the original rows to check the solve stage and to restart benchmark runs
+    int nrhs=env_int("NRHS",0);
+    bench_t bench;
+    bench_init(&bench);
+    int run,runs=bench_runs(&bench);
+    double ** localA0=NULL;
+    if (nrhs>0 || runs>1) {
+        localA0=malloc2D(x,W);
+        copy2D(localA0,localA,x,W);
+    }
+
+    //Timers
+    struct timeval ts,tf,time1,time2;
+    double total_time=0,computation_time=0,communication_time=0,run_time;
+
+    for (run=0;run<runs;run++) {
+        //Every benchmark run starts again from the original rows
+        if (run>0)
+            copy2D(localA,localA0,x,W);
+        communication_time=0;
+        MPI_Barrier(MPI_COMM_WORLD);
+        gettimeofday(&ts,NULL);
+
+        //Waiting for the previous process counts as communication
+        gettimeofday(&time1,NULL);
+        if (rank>0 && kl>0)
+            MPI_Recv(halo[0],kl*W,MPI_DOUBLE,rank-1,TAG_HALO,MPI_COMM_WORLD,MPI_STATUS_IGNORE);
+        gettimeofday(&time2,NULL);
+        communication_time+=time2.tv_sec-time1.tv_sec+(time2.tv_usec-time1.tv_usec)*0.000001;
+
+        lu_band_rows(localA,g0,x,N,kl,ku);
+
+        gettimeofday(&time1,NULL);
+        if (rank<size-1 && kl>0)
+            MPI_Send(localA[x-kl],kl*W,MPI_DOUBLE,rank+1,TAG_HALO,MPI_COMM_WORLD);
+        gettimeofday(&time2,NULL);
+        communication_time+=time2.tv_sec-time1.tv_sec+(time2.tv_usec-time1.tv_usec)*0.000001;
+
+        gettimeofday(&tf,NULL);
+        total_time=tf.tv_sec-ts.tv_sec+(tf.tv_usec-ts.tv_usec)*0.000001;
+        computation_time=total_time-communication_time;
+        MPI_Reduce(&total_time,&run_time,1,MPI_DOUBLE,MPI_MAX,0,MPI_COMM_WORLD);
+        bench_time(&bench,run,run_time);
+    }
+
+    double avg_total,avg_comp,avg_comm,max_total,max_comp,max_comm;
+    MPI_Reduce(&total_time,&max_total,1,MPI_DOUBLE,MPI_MAX,0,MPI_COMM_WORLD);
+    MPI_Reduce(&computation_time,&max_comp,1,MPI_DOUBLE,MPI_MAX,0,MPI_COMM_WORLD);
+    MPI_Reduce(&communication_time,&max_comm,1,MPI_DOUBLE,MPI_MAX,0,MPI_COMM_WORLD);
+    MPI_Reduce(&total_time,&avg_total,1,MPI_DOUBLE,MPI_SUM,0,MPI_COMM_WORLD);
+    MPI_Reduce(&computation_time,&avg_comp,1,MPI_DOUBLE,MPI_SUM,0,MPI_COMM_WORLD);
+    MPI_Reduce(&communication_time,&avg_comm,1,MPI_DOUBLE,MPI_SUM,0,MPI_COMM_WORLD);
+
+    avg_total/=size;
+    avg_comp/=size;
+    avg_comm/=size;
+    if (rank==0) {
+        printf("LU-Band-block\tArray Size\t%d\tBand\t%d\t%d\tProcesses\t%d\n",N,kl,ku,size);
+        printf("Max time:\tTotal\t%lf\tComputation\t%lf\tCommunication\t%lf\n",max_total,max_comp,max_comm);
+        printf("Avg time:\tTotal\t%lf\tComputation\t%lf\tCommunication\t%lf\n",avg_total,avg_comp,avg_comm);
+        bench_report_flops(&bench,"LU-Band-block",N,size,1,(double)N*kl*(2*ku+1));
+    }
+
+    //Write the factors in band storage
+    output_rows(localA,x,N,W,DIST_BLOCK,filename,MPI_COMM_WORLD);
+
+    //Solve for a batch of NRHS right-hand sides with the distributed factors:
+    //forward substitution from the first process to the last with halos of
+    //kl rows of Z, back substitution the other way with halos of ku rows of X
+    if (nrhs>0) {
+        double ** localB0=malloc2D(x,nrhs);
+        double ** bhalo=malloc2D(kl+x+ku,nrhs), ** localB=&bhalo[kl];
+        random_rows(localB,x,N,nrhs,DIST_BLOCK,RAND_RHS,MPI_COMM_WORLD);
+        copy2D(localB0,localB,x,nrhs);
+        MPI_Barrier(MPI_COMM_WORLD);
+        gettimeofday(&ts,NULL);
+        communication_time=0;
+
+        gettimeofday(&time1,NULL);
+        if (rank>0 && kl>0)
+            MPI_Recv(bhalo[0],kl*nrhs,MPI_DOUBLE,rank-1,TAG_HALO,MPI_COMM_WORLD,MPI_STATUS_IGNORE);
+        gettimeofday(&time2,NULL);
+        communication_time+=time2.tv_sec-time1.tv_sec+(time2.tv_usec-time1.tv_usec)*0.000001;
+        forward_band(localA,localB,g0,x,N,kl,nrhs);
+        if (rank<size-1 && kl>0)
+            MPI_Send(localB[x-kl],kl*nrhs,MPI_DOUBLE,rank+1,TAG_HALO,MPI_COMM_WORLD);
+
+        gettimeofday(&time1,NULL);
+        if (rank<size-1 && ku>0)
+            MPI_Recv(localB[x],ku*nrhs,MPI_DOUBLE,rank+1,TAG_HALO,MPI_COMM_WORLD,MPI_STATUS_IGNORE);
+        gettimeofday(&time2,NULL);
+        communication_time+=time2.tv_sec-time1.tv_sec+(time2.tv_usec-time1.tv_usec)*0.000001;
+        backward_band(localA,localB,g0,x,N,kl,ku,nrhs);
+        if (rank>0 && ku>0)
+            MPI_Send(localB[0],ku*nrhs,MPI_DOUBLE,rank-1,TAG_HALO,MPI_COMM_WORLD);
+        gettimeofday(&tf,NULL);
+        total_time=tf.tv_sec-ts.tv_sec+(tf.tv_usec-ts.tv_usec)*0.000001;
+
+        //The residual needs the kl rows of X before and the ku rows after
+        if (kl>0)
+            MPI_Sendrecv(localB[x-kl],kl*nrhs,MPI_DOUBLE,rank<size-1 ? rank+1 : MPI_PROC_NULL,TAG_HALO,
+                    bhalo[0],kl*nrhs,MPI_DOUBLE,rank>0 ? rank-1 : MPI_PROC_NULL,TAG_HALO,MPI_COMM_WORLD,MPI_STATUS_IGNORE);
+        if (ku>0)
+            MPI_Sendrecv(localB[0],ku*nrhs,MPI_DOUBLE,rank>0 ? rank-1 : MPI_PROC_NULL,TAG_HALO,
+                    localB[x],ku*nrhs,MPI_DOUBLE,rank<size-1 ? rank+1 : MPI_PROC_NULL,TAG_HALO,MPI_COMM_WORLD,MPI_STATUS_IGNORE);
+        residual_band(localA0,localB,localB0,g0,x,N,kl,ku,nrhs,max);
+        MPI_Reduce(max,gmax,3,MPI_DOUBLE,MPI_MAX,0,MPI_COMM_WORLD);
+        MPI_Reduce(&total_time,&max_total,1,MPI_DOUBLE,MPI_MAX,0,MPI_COMM_WORLD);
+        MPI_Reduce(&communication_time,&max_comm,1,MPI_DOUBLE,MPI_MAX,0,MPI_COMM_WORLD);
+        if (rank==0) {
+            printf("LU-Band-block-Solve\tRHS\t%d\tMax time:\tTotal\t%lf\tCommunication\t%lf\tResidual\t%e\n",
+                    nrhs,max_total,max_comm,gmax[0]/(gmax[1]*gmax[2]*N));
+        }
+        free2D(bhalo,kl+x+ku,nrhs);
+        free2D(localB0,x,nrhs);
+    }
+    if (localA0!=NULL)
+        free2D(localA0,x,W);
+    free2D(halo,kl+x,W);
+
+    MPI_Finalize();
+
+    return 0;
+}
@@ -0,0 +1,75 @@
+/**************************************************
+# Copyright (C) 2014 Raptis Dimos <raptis.dimos@yahoo.gr>
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+# **************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <omp.h>
+#include "utils.h"
+#include "batch.h"
+
+//Factor count random n x n matrices with the batched API
+
+
+int main(int argc, char * argv[])
+{
+    if (argc<3) {
+        fprintf(stderr,"Usage: %s n count\n",argv[0]);
+        exit(-1);
+    }
+    int n=atoi(argv[1]);
+    int count=atoi(argv[2]);
+    if (n<1 || count<1) {
+        fprintf(stderr,"Usage: %s n count\n",argv[0]);
+        exit(-1);
+    }
+    //The matrices one below the other, matrix m is rows m*n..m*n+n-1
+    double ** A=malloc2D(count*n,n);
+    init2D(A,count*n,n);
+    int threads=omp_get_max_threads();
+    struct timeval ts,tf;
+    double total_time=0;
+
+    bench_t bench;
+    bench_init(&bench);
+    int run,runs=bench_runs(&bench);
+    double ** A0=NULL;
+    if (runs>1) {
+        A0=malloc2D(count*n,n);
+        copy2D(A0,A,count*n,n);
+    }
+
+    for (run=0;run<runs;run++) {
+        //Every benchmark run starts again from the original matrices
+        if (run>0)
+            copy2D(A,A0,count*n,n);
+        gettimeofday(&ts,NULL);
+        lu_batch(A[0],n,count);
+        gettimeofday(&tf,NULL);
+        total_time=(tf.tv_sec-ts.tv_sec)+(tf.tv_usec-ts.tv_usec)*0.000001;
+        bench_time(&bench,run,total_time);
+    }
+    printf("LU-Batch\t%d\t%d\t%.3lf\tLayout\t%s\tThreads\t%d\n",n,count,total_time,
+            n<=BATCH_INTERLEAVE_MAX ? "interleaved" : "rows",threads);
+    printf("Matrices/s\t%.0lf\tGFLOP/s\t%.2lf\n",count/total_time,2.0*n*n*n/3.0*count/total_time*1e-9);
+    bench_report_flops(&bench,"LU-Batch",n,1,threads,2.0*n*n*n/3.0*count);
+
+    char * filename="output_batch";
+    output2D(A,count*n,n,filename);
+
+    if (A0!=NULL)
+        free2D(A0,count*n,n);
+    free2D(A,count*n,n);
+	return 0;
+}
@@ -15,117 +15,191 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <mpi.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 #include <sys/time.h>
 #include "utils.h"
+#include "mpi_utils.h"
+
+//Default segment of the pipelined relay, in elements
+#define SEGMENT 512
+
+#define MIN(a,b) ((a)<(b)?(a):(b))
 
 
 int main (int argc, char * argv[]) {
     int rank,size;
+#ifdef _OPENMP
+    //Hybrid build: only the master thread talks to MPI
+    int provided;
+    MPI_Init_thread(&argc,&argv,MPI_THREAD_FUNNELED,&provided);
+    if (provided<MPI_THREAD_FUNNELED) {
+        fprintf(stderr,"The MPI library does not support MPI_THREAD_FUNNELED!\n");
+        MPI_Abort(MPI_COMM_WORLD,-1);
+    }
+#else
     MPI_Init(&argc,&argv);
+#endif
     MPI_Comm_size(MPI_COMM_WORLD,&size);
     MPI_Comm_rank(MPI_COMM_WORLD,&rank);
 
-    int X,Y,x,y,X_ext,i,j,k,thread,t,count,initial;
-    double ** A, ** localA,*temp_line,l;
-    X=atoi(argv[1]);
+    int X,Y,x,y,i,j,k,thread,t,count,initial;
+    int mode,segment,s0,cnt,g,nreqs;
+    double * pivot, * mult;
+    MPI_Request * reqs;
+    double ** localA,*temp_line;
+    X=input_size(argv[1]);
     Y=X;
+    //Number of right-hand sides to solve for after the factorization
+    int nrhs=env_int("NRHS",0);
+    int verify=env_int("VERIFY",0);
+    double ** localA0=NULL;
+    //Warmup and timed runs of the benchmark mode
+    bench_t bench;
+    int run,runs,threads=1;
+    //Pivot row distribution: send loop (default), pipelined ring or tree
+    mode=RELAY_LOOP;
+    if (argc>2)
+        mode=relay_mode(argv[2]);
+    segment=SEGMENT;
+    if (argc>3)
+        segment=atoi(argv[3]);
+    if (segment<1)
+        segment=SEGMENT;
     MPI_Status status;
-    FILE *fp;
     char * filename="output_block_p2p";
    
     temp_line =(double *)malloc(Y*sizeof(double));
-    //Extend dimension X with ghost cells if X%size!=0
-    if (X%size!=0)
-        X_ext=X+size-X%size;
-    else
-        X_ext=X;
-
-    if (rank==0) {
-        //Allocate and init matrix A
-        A=malloc2D(X_ext,Y);
-        init2D(A,X,Y);
-        fp = fopen("output_block_p2p","w");
-        fprintf(fp,"\n****Initial Array****\n");
-        fclose(fp);
-        print2DFile(A,X,Y,filename);
 
-    }
-      
     //Local dimensions x,y
-    x=X_ext/size;
+    x=(X+size-1)/size;
     y=Y;
-    
 
-    //Allocate local matrix and scatter global matrix
+    //Allocate local matrix, every rank reads its own rows of a matrix
+    //file or makes its own rows of a random array
     localA=malloc2D(x,y);
-    double * idx;
-    if (rank==0) 
-        idx=&A[0][0];
-    MPI_Scatter(idx,x*y,MPI_DOUBLE,&localA[0][0],x*y,MPI_DOUBLE,0,MPI_COMM_WORLD);
- 
-   if (rank==0) {
-        free2D(A,X_ext,Y);
+    input_rows(argv[1],localA,x,X,Y,DIST_BLOCK,filename,MPI_COMM_WORLD);
+    //Keep the original rows to check the factors and the solve stage and to
+    //restart benchmark runs
+    bench_init(&bench);
+    runs=bench_runs(&bench);
+    if (nrhs>0 || runs>1 || verify) {
+        localA0=malloc2D(x,y);
+        copy2D(localA0,localA,x,y);
     }
 
     //Timers   
-    struct timeval ts,tf,time1,time2;
-    double total_time=0,computation_time=0,communication_time=0;
+    struct timeval ts,tf,time1,time2,time3,time4;
+    double total_time=0,computation_time=0,communication_time=0,threaded_time=0,run_time;
 
-	MPI_Barrier(MPI_COMM_WORLD);
-    gettimeofday(&ts,NULL);        
+    for (run=0;run<runs;run++) {
+        //Every benchmark run starts again from the original rows
+        if (run>0)
+            copy2D(localA,localA0,x,y);
+        communication_time=0;
+        threaded_time=0;
+        MPI_Barrier(MPI_COMM_WORLD);
+        gettimeofday(&ts,NULL);        
 
-    for (k=0;k<X-1;k++){
-        if ( rank == ( k / x)  ){              
-            for(thread=0;thread < size;thread++){           
-                if(thread != ( k / x) ){                
+        if (mode==RELAY_LOOP) {
+            for (k=0;k<X-1;k++){
+                MPI_Pcontrol(TRACE_STEP,k);
+                if ( rank == ( k / x)  ){              
                     gettimeofday(&time1,NULL);
-				   MPI_Send(&(localA[k % x][0]),Y,MPI_DOUBLE,thread,55,MPI_COMM_WORLD);   
+                    for(thread=0;thread < size;thread++){           
+                        if(thread != ( k / x) ){                
+                           MPI_Send(&(localA[k % x][0]),Y,MPI_DOUBLE,thread,55,MPI_COMM_WORLD);   
+                        }
+                    }
+                    gettimeofday(&time2,NULL);
                 }
-			    gettimeofday(&time2,NULL);
-            }
-        }
-        else {        
-            gettimeofday(&time1,NULL);
-            MPI_Recv(&(temp_line[0]),Y,MPI_DOUBLE,(k / x),55,MPI_COMM_WORLD,&status);
-            gettimeofday(&time2,NULL);
-        }
-        communication_time+=time2.tv_sec-time1.tv_sec+(time2.tv_usec-time1.tv_usec)*0.000001;
-        if(k < (((rank+1)*x)-1) ){ 
+                else {        
+                    gettimeofday(&time1,NULL);
+                    MPI_Recv(&(temp_line[0]),Y,MPI_DOUBLE,(k / x),55,MPI_COMM_WORLD,&status);
+                    gettimeofday(&time2,NULL);
+                }
+                communication_time+=time2.tv_sec-time1.tv_sec+(time2.tv_usec-time1.tv_usec)*0.000001;
+                if(k < (((rank+1)*x)-1) ){ 
 
-            if(k <= (((rank)*x)-1) ){            
-                initial = 0;
-            }
-            else{                                 
-                initial = ((k % (x) ) + 1);
-            }
-            for(i= initial ;i<x ;i++){
+                    if(k <= (((rank)*x)-1) ){            
+                        initial = 0;
+                    }
+                    else{                                 
+                        initial = ((k % (x) ) + 1);
+                    }
+                    gettimeofday(&time3,NULL);
+#ifdef _OPENMP
+                    #pragma omp parallel for schedule(static)
+#endif
+                    for(i= initial ;i<x ;i++){
 
-                if( rank != ( k / x) ){               
-                    l = localA[i][k] / temp_line[k];
-                    for(j=k;j<X;j++){
-                        localA[i][j] = localA[i][j]-l*temp_line[j];
+                        if( rank != ( k / x) ){               
+                            eliminate_row(localA[i],temp_line,k,X);
+                        }
+                        else{
+                            eliminate_row(localA[i],localA[k % x],k,X);
+                        }
                     }
+                    gettimeofday(&time4,NULL);
+                    threaded_time+=time4.tv_sec-time3.tv_sec+(time4.tv_usec-time3.tv_usec)*0.000001;
                 }
-                else{
-                    l = localA[i][k] / localA[k % x][k];
-                    for(j=k;j<X;j++){
-                        localA[i][j] = localA[i][j]-l*localA[k % x][j];
+            }
+        }
+        else {
+            //Pipelined relay: the row travels in segments from process to
+            //process, each one forwards a segment and applies it to its own
+            //rows while the next segment is still on the way
+            mult=(double *)malloc(x*sizeof(double));
+            reqs=(MPI_Request *)malloc(relay_max_requests(Y,segment)*sizeof(MPI_Request));
+            for (k=0;k<X-1;k++){
+                MPI_Pcontrol(TRACE_STEP,k);
+                if ( rank == ( k / x) )
+                    pivot=localA[k % x];
+                else
+                    pivot=temp_line;
+                nreqs=0;
+                for (s0=k;s0<Y;s0+=segment){
+                    cnt=MIN(segment,Y-s0);
+                    gettimeofday(&time1,NULL);
+                    relay_segment(pivot,s0,cnt,( k / x),mode,MPI_COMM_WORLD,reqs,&nreqs);
+                    gettimeofday(&time2,NULL);
+                    communication_time+=time2.tv_sec-time1.tv_sec+(time2.tv_usec-time1.tv_usec)*0.000001;
+                    gettimeofday(&time3,NULL);
+#ifdef _OPENMP
+                    #pragma omp parallel for private(j,g) schedule(static)
+#endif
+                    for(i=0;i<x;i++){
+                        g=rank*x+i;
+                        if(g <= k)
+                            continue;
+                        if(s0 == k){
+                            mult[i] = localA[i][k] / pivot[k];
+                            localA[i][k] = mult[i];
+                        }
+                        j = (s0 == k ? k+1 : s0);
+                        axpy_row(&localA[i][j],&pivot[j],mult[i],s0+cnt-j);
                     }
+                    gettimeofday(&time4,NULL);
+                    threaded_time+=time4.tv_sec-time3.tv_sec+(time4.tv_usec-time3.tv_usec)*0.000001;
                 }
+                gettimeofday(&time1,NULL);
+                MPI_Waitall(nreqs,reqs,MPI_STATUSES_IGNORE);
+                gettimeofday(&time2,NULL);
+                communication_time+=time2.tv_sec-time1.tv_sec+(time2.tv_usec-time1.tv_usec)*0.000001;
             }
+            free(mult);
+            free(reqs);
         }
-    }
-
-    gettimeofday(&tf,NULL);
-    total_time=tf.tv_sec-ts.tv_sec+(tf.tv_usec-ts.tv_usec)*0.000001;
-    computation_time=total_time-communication_time;
 
-    //Gather local matrices back to the global matrix
-    if (rank==0) {
-        A=malloc2D(X_ext,Y);    
-        idx=&A[0][0];
+        MPI_Pcontrol(TRACE_STEP,-1);
+        gettimeofday(&tf,NULL);
+        total_time=tf.tv_sec-ts.tv_sec+(tf.tv_usec-ts.tv_usec)*0.000001;
+        computation_time=total_time-communication_time;
+        MPI_Reduce(&total_time,&run_time,1,MPI_DOUBLE,MPI_MAX,0,MPI_COMM_WORLD);
+        bench_time(&bench,run,run_time);
     }
-    MPI_Gather(&localA[0][0],x*y,MPI_DOUBLE,idx,x*y,MPI_DOUBLE,0,MPI_COMM_WORLD);
+
     
     MPI_Barrier(MPI_COMM_WORLD);
 
@@ -136,27 +210,74 @@ int main (int argc, char * argv[]) {
     MPI_Reduce(&total_time,&avg_total,1,MPI_DOUBLE,MPI_SUM,0,MPI_COMM_WORLD);
     MPI_Reduce(&computation_time,&avg_comp,1,MPI_DOUBLE,MPI_SUM,0,MPI_COMM_WORLD);
     MPI_Reduce(&communication_time,&avg_comm,1,MPI_DOUBLE,MPI_SUM,0,MPI_COMM_WORLD);
+#ifdef _OPENMP
+    double avg_thr,max_thr;
+    MPI_Reduce(&threaded_time,&max_thr,1,MPI_DOUBLE,MPI_MAX,0,MPI_COMM_WORLD);
+    MPI_Reduce(&threaded_time,&avg_thr,1,MPI_DOUBLE,MPI_SUM,0,MPI_COMM_WORLD);
+    avg_thr/=size;
+#endif
 
     avg_total/=size;
     avg_comp/=size;
     avg_comm/=size;
 
     if (rank==0) {
-        printf("LU-Block-p2p\tSize\t%d\tProcesses\t%d\n",X,size);
+        if (mode!=RELAY_LOOP)
+            printf("LU-Block-p2p\tSize\t%d\tProcesses\t%d\tRelay\t%s\tSegment\t%d\n",X,size,relay_name(mode),segment);
+        else
+            printf("LU-Block-p2p\tSize\t%d\tProcesses\t%d\n",X,size);
         printf("Max time:\tTotal\t%lf\tComputation\t%lf\tCommunication\t%lf\n",max_total,max_comp,max_comm);
         printf("Avg time:\tTotal\t%lf\tComputation\t%lf\tCommunication\t%lf\n",avg_total,avg_comp,avg_comm);
+#ifdef _OPENMP
+        printf("Threads per process\t%d\tThreaded computation:\tMax\t%lf\tAvg\t%lf\n",omp_get_max_threads(),max_thr,avg_thr);
+#endif
+        printf("Per-step communication:\tMax\t%lf\tAvg\t%lf\n",max_comm/(X-1),avg_comm/(X-1));
     }
 
-    //Print triangular matrix U to file
-    if (rank==0) {
-        fp = fopen("output_block_p2p","a");
-        fprintf(fp,"\n****Final Array****\n");
-        fclose(fp);
- 
-        print2DFile(A,X,Y,filename);
+#ifdef _OPENMP
+    threads=omp_get_max_threads();
+#endif
+    if (rank==0)
+        bench_report(&bench,"LU-Block-p2p",X,size,threads);
+
+    //Write triangular matrix U and the multipliers
+    output_rows(localA,x,X,Y,DIST_BLOCK,filename,MPI_COMM_WORLD);
+
+    //Check the factors against the original rows
+    if (verify) {
+        MPI_Barrier(MPI_COMM_WORLD);
+        gettimeofday(&ts,NULL);
+        double residual=verify_dist(localA0,localA,x,X,DIST_BLOCK,MPI_COMM_WORLD);
+        gettimeofday(&tf,NULL);
+        total_time=tf.tv_sec-ts.tv_sec+(tf.tv_usec-ts.tv_usec)*0.000001;
+        if (rank==0)
+            verify_report("LU-Block-p2p",residual,total_time);
     }
 
 
+    //Solve for a batch of NRHS right-hand sides with the distributed factors
+    if (nrhs>0) {
+        double ** localB=malloc2D(x,nrhs), ** localB0=malloc2D(x,nrhs);
+        random_rows(localB,x,X,nrhs,DIST_BLOCK,RAND_RHS,MPI_COMM_WORLD);
+        for (i=0;i<x;i++)
+            for (j=0;j<nrhs;j++)
+                localB0[i][j]=localB[i][j];
+        MPI_Barrier(MPI_COMM_WORLD);
+        gettimeofday(&ts,NULL);
+        communication_time=solve_dist(localA,x,X,localB,nrhs,DIST_BLOCK,MPI_COMM_WORLD);
+        gettimeofday(&tf,NULL);
+        total_time=tf.tv_sec-ts.tv_sec+(tf.tv_usec-ts.tv_usec)*0.000001;
+        double residual=residual_dist(localA0,localB,localB0,x,X,nrhs,DIST_BLOCK,MPI_COMM_WORLD);
+        MPI_Reduce(&total_time,&max_total,1,MPI_DOUBLE,MPI_MAX,0,MPI_COMM_WORLD);
+        MPI_Reduce(&communication_time,&max_comm,1,MPI_DOUBLE,MPI_MAX,0,MPI_COMM_WORLD);
+        if (rank==0)
+            printf("LU-Block-p2p-Solve\tRHS\t%d\tMax time:\tTotal\t%lf\tCommunication\t%lf\tResidual\t%e\n",nrhs,max_total,max_comm,residual);
+        free2D(localB,x,nrhs);
+        free2D(localB0,x,nrhs);
+    }
+    if (localA0!=NULL)
+        free2D(localA0,x,y);
+
     MPI_Finalize();
 
     return 0;
@@ -0,0 +1,120 @@
+/**************************************************
+# Copyright (C) 2014 Raptis Dimos <raptis.dimos@yahoo.gr>
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+# **************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include "utils.h"
+
+//Default panel width and column tile of the trailing update
+#define PANEL 64
+#define TILE 256
+
+#define MIN(a,b) ((a)<(b)?(a):(b))
+
+
+int main(int argc, char * argv[])
+{
+    int X=input_size(argv[1]);
+    int Y=X;
+    int nb=PANEL;
+    if (argc>2)
+        nb=atoi(argv[2]);
+    if (nb<1)
+        nb=1;
+    double ** A=malloc2D(X,Y);
+    input2D(A,X,Y,argv[1]);
+    int i,j,k,p,kb,kend,jj,jend;
+    struct timeval ts,tf;
+    double total_time=0;
+
+    //Keep a copy of A to check the factors and the solve stage and to restart
+    //benchmark runs
+    int nrhs=env_int("NRHS",0);
+    int verify=env_int("VERIFY",0);
+    bench_t bench;
+    bench_init(&bench);
+    int run,runs=bench_runs(&bench);
+    double ** A0=NULL, ** B, ** B0;
+    if (nrhs>0 || runs>1 || verify) {
+        A0=malloc2D(X,Y);
+        copy2D(A0,A,X,Y);
+    }
+
+    for (run=0;run<runs;run++) {
+        //Every benchmark run starts again from the original array
+        if (run>0)
+            copy2D(A,A0,X,Y);
+        gettimeofday(&ts,NULL);
+        for (kb=0;kb<X-1;kb+=nb) {
+            kend=MIN(kb+nb,X);
+
+            //Factor panel A[kb:X][kb:kend], multipliers are kept below the diagonal
+            for (k=kb;k<kend;k++)
+                for (i=k+1;i<X;i++)
+                    eliminate_row(A[i],A[k],k,kend);
+
+            //Apply the panel to the block row A[kb:kend][kend:Y]
+            for (k=kb;k<kend;k++)
+                for (i=k+1;i<kend;i++)
+                    axpy_row(&A[i][kend],&A[k][kend],A[i][k],Y-kend);
+
+            //Trailing update A22-=L21*U12, tiled over columns so that each
+            //tile of U12 stays in cache while all trailing rows stream past it
+            for (jj=kend;jj<Y;jj+=TILE) {
+                jend=MIN(jj+TILE,Y);
+                for (i=kend;i<X;i++)
+                    for (p=kb;p<kend;p++)
+                        axpy_row(&A[i][jj],&A[p][jj],A[i][p],jend-jj);
+            }
+        }
+        gettimeofday(&tf,NULL);
+        total_time=(tf.tv_sec-ts.tv_sec)+(tf.tv_usec-ts.tv_usec)*0.000001;
+        bench_time(&bench,run,total_time);
+    }
+	printf("LU-Blocked\t%d\t%d\t%.3lf\n",X,nb,total_time);
+    bench_report(&bench,"LU-Blocked",X,1,1);
+
+    char * filename="output_blocked";
+    output2D(A,X,Y,filename);
+
+    //Check the factors against the original array
+    if (verify) {
+        gettimeofday(&ts,NULL);
+        double residual=verify2D(A0,A,X);
+        gettimeofday(&tf,NULL);
+        total_time=(tf.tv_sec-ts.tv_sec)+(tf.tv_usec-ts.tv_usec)*0.000001;
+        verify_report("LU-Blocked",residual,total_time);
+    }
+
+    //Solve for a batch of NRHS right-hand sides with the factors
+    if (nrhs>0) {
+        B=malloc2D(X,nrhs);
+        B0=malloc2D(X,nrhs);
+        init2DRHS(B,X,nrhs);
+        for (i=0;i<X;i++)
+            for (j=0;j<nrhs;j++)
+                B0[i][j]=B[i][j];
+        gettimeofday(&ts,NULL);
+        solve2D(A,X,B,0,nrhs);
+        gettimeofday(&tf,NULL);
+        total_time=(tf.tv_sec-ts.tv_sec)+(tf.tv_usec-ts.tv_usec)*0.000001;
+        printf("LU-Blocked-Solve\t%d\t%d\t%.3lf\tResidual\t%e\n",X,nrhs,total_time,residual2D(A0,B,B0,X,nrhs));
+        free2D(B,X,nrhs);
+        free2D(B0,X,nrhs);
+    }
+    if (A0!=NULL)
+        free2D(A0,X,Y);
+    return 0;
+}
@@ -0,0 +1,206 @@
+/**************************************************
+# Copyright (C) 2014 Raptis Dimos <raptis.dimos@yahoo.gr>
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+# **************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <sys/time.h>
+#include "utils.h"
+
+//Blocked Cholesky factorization A=U^T*U of a symmetric positive definite
+//matrix. Only the upper triangle is read and written (the lower triangle
+//of A by columns), so the pivot row is contiguous and the trailing update
+//uses the same row kernel as LU on half the elements. Built once as
+//lu_chol and once with openMP as lu_omp_chol. With SPD_CHECK=1 the input
+//is checked for symmetry and a non-positive pivot restarts the
+//factorization as LU instead of stopping.
+#ifdef _OPENMP
+#include <omp.h>
+#define OMP(x) _Pragma(#x)
+#else
+#define OMP(x)
+#endif
+
+//Default panel width and column tile of the trailing update
+#define PANEL 64
+#define TILE 256
+
+#define MIN(a,b) ((a)<(b)?(a):(b))
+#define MAX(a,b) ((a)>(b)?(a):(b))
+
+//Returns -1, or the first row with a non-positive pivot
+static int cholesky(double ** A, int N, int nb) {
+    int i,j,k,p,kb,kend,jj,jend,j0;
+    double d;
+    for (kb=0;kb<N;kb+=nb) {
+        kend=MIN(kb+nb,N);
+
+        //Diagonal block, serial
+        for (k=kb;k<kend;k++) {
+            d=A[k][k];
+            if (!(d>0))
+                return k;
+            d=sqrt(d);
+            A[k][k]=d;
+            for (j=k+1;j<kend;j++)
+                A[k][j]/=d;
+            for (i=k+1;i<kend;i++)
+                axpy_row(&A[i][i],&A[k][i],A[k][i],kend-i);
+        }
+
+        OMP(omp parallel private(i,j,k,p,jj,jend,j0,d))
+        {
+            //Block row U12 right of the diagonal block, independent per column tile
+            OMP(omp for schedule(static))
+            for (jj=kend;jj<N;jj+=TILE) {
+                jend=MIN(jj+TILE,N);
+                for (k=kb;k<kend;k++) {
+                    d=1.0/A[k][k];
+                    for (j=jj;j<jend;j++)
+                        A[k][j]*=d;
+                    for (i=k+1;i<kend;i++)
+                        axpy_row(&A[i][jj],&A[k][jj],A[k][i],jend-jj);
+                }
+            }
+
+            //Trailing update of the upper triangle A22-=U12^T*U12 one column
+            //tile at a time, only rows above the end of the tile take part
+            for (jj=kend;jj<N;jj+=TILE) {
+                jend=MIN(jj+TILE,N);
+                OMP(omp for schedule(static) nowait)
+                for (i=kend;i<jend;i++) {
+                    j0=MAX(jj,i);
+                    for (p=kb;p<kend;p++)
+                        axpy_row(&A[i][j0],&A[p][j0],A[p][i],jend-j0);
+                }
+            }
+        }
+    }
+    return -1;
+}
+
+//Right-looking LU for the inputs that turn out not to be SPD
+static void lu(double ** A, int N) {
+    int i,k;
+    for (k=0;k<N-1;k++) {
+        OMP(omp parallel for schedule(static))
+        for (i=k+1;i<N;i++)
+            eliminate_row(A[i],A[k],k,N);
+    }
+}
+
+
+int main(int argc, char * argv[])
+{
+    int X=input_size(argv[1]);
+    int nb=PANEL;
+    if (argc>2)
+        nb=atoi(argv[2]);
+    if (nb<1)
+        nb=1;
+    double ** A=malloc2D(X,X);
+    if (input_is_file(argv[1]))
+        input2D(A,X,X,argv[1]);
+    else
+        init2DSPD(A,X);
+    int threads=1,fail=-1,spd=1;
+    struct timeval ts,tf;
+    double total_time=0;
+#ifdef _OPENMP
+    char * name="LU-OpenMP-Cholesky", * filename="output_omp_chol";
+    threads=omp_get_max_threads();
+#else
+    char * name="LU-Cholesky", * filename="output_chol";
+#endif
+
+    //Without the check a matrix that is not SPD stops the program
+    int check=env_int("SPD_CHECK",0);
+    if (check && !symmetric2D(A,X)) {
+        printf("%s\tInput is not symmetric, using LU\n",name);
+        spd=0;
+    }
+
+    //Keep a copy of A to check the solve stage, to restart benchmark runs
+    //and to fall back to LU
+    int nrhs=env_int("NRHS",0);
+    bench_t bench;
+    bench_init(&bench);
+    int run,runs=bench_runs(&bench);
+    double ** A0=NULL, ** B, ** B0;
+    if (nrhs>0 || runs>1 || check) {
+        A0=malloc2D(X,X);
+        copy2D(A0,A,X,X);
+    }
+
+    for (run=0;run<runs;run++) {
+        //Every benchmark run starts again from the original array
+        if (run>0)
+            copy2D(A,A0,X,X);
+        gettimeofday(&ts,NULL);
+        if (spd) {
+            fail=cholesky(A,X,nb);
+            if (fail>=0) {
+                if (!check) {
+                    fprintf(stderr,"%s: pivot %d is not positive, the matrix is not SPD (SPD_CHECK=1 falls back to LU)\n",name,fail);
+                    exit(-1);
+                }
+                spd=0;
+                copy2D(A,A0,X,X);
+            }
+        }
+        if (!spd)
+            lu(A,X);
+        gettimeofday(&tf,NULL);
+        total_time=(tf.tv_sec-ts.tv_sec)+(tf.tv_usec-ts.tv_usec)*0.000001;
+        bench_time(&bench,run,total_time);
+    }
+    if (fail>=0)
+        printf("%s\tPivot %d is not positive, fell back to LU\n",name,fail);
+    printf("%s\t%d\t%d\t%.3lf\n",name,X,nb,total_time);
+    bench_report_flops(&bench,name,X,1,threads,spd ? (double)X*X*X/3.0 : 2.0*X*X*X/3.0);
+
+    //U in the upper triangle, the lower triangle keeps A (or L and U after LU)
+    output2D(A,X,X,filename);
+
+    //Solve for a batch of NRHS right-hand sides with the factors
+    if (nrhs>0) {
+        B=malloc2D(X,nrhs);
+        B0=malloc2D(X,nrhs);
+        init2DRHS(B,X,nrhs);
+        copy2D(B0,B,X,nrhs);
+        gettimeofday(&ts,NULL);
+        OMP(omp parallel)
+        {
+            //Right-hand sides are independent, every thread solves a slice
+            int t=0,nt=1;
+#ifdef _OPENMP
+            t=omp_get_thread_num();
+            nt=omp_get_num_threads();
+#endif
+            if (spd)
+                solve_chol2D(A,X,B,nrhs*t/nt,nrhs*(t+1)/nt);
+            else
+                solve2D(A,X,B,nrhs*t/nt,nrhs*(t+1)/nt);
+        }
+        gettimeofday(&tf,NULL);
+        total_time=(tf.tv_sec-ts.tv_sec)+(tf.tv_usec-ts.tv_usec)*0.000001;
+        printf("%s-Solve\t%d\t%d\t%.3lf\tResidual\t%e\n",name,X,nrhs,total_time,residual2D(A0,B,B0,X,nrhs));
+        free2D(B,X,nrhs);
+        free2D(B0,X,nrhs);
+    }
+    if (A0!=NULL)
+        free2D(A0,X,X);
+    free2D(A,X,X);
+	return 0;
+}
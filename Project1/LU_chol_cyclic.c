@@ -0,0 +1,253 @@
+/**************************************************
+# Copyright (C) 2014 Raptis Dimos <raptis.dimos@yahoo.gr>
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+# **************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <mpi.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include <sys/time.h>
+#include "utils.h"
+#include "mpi_utils.h"
+
+//Cholesky factorization A=U^T*U with the rows distributed cyclically, as
+//in LU_cyclic_bcast. At step k the owner of row k takes the square root of
+//the pivot, scales the row and broadcasts its part right of the diagonal;
+//every process subtracts U[k][g]*U[k][g:N] from each of its rows g>k, so
+//only the upper triangle is touched. A non-positive pivot travels with the
+//row and stops every process at the same step. With SPD_CHECK=1 the input
+//is checked for symmetry and such a pivot restarts the factorization as LU.
+
+
+//1 on every process if the distributed rows form a symmetric matrix: every
+//row k is broadcast and compared with column k of the rows below it
+static int symmetric_rows(double ** localA, int x, int X, double * line, int rank, int size) {
+    int i,k,g,sym=1,all;
+    for (k=0;k<X;k++) {
+        if (rank==k%size)
+            for (i=0;i<X;i++)
+                line[i]=localA[k/size][i];
+        MPI_Bcast(line,X,MPI_DOUBLE,k%size,MPI_COMM_WORLD);
+        for (i=0;i<x;i++) {
+            g=i*size+rank;
+            if (g>k && g<X && fabs(localA[i][k]-line[g])>1e-12*(fabs(localA[i][k])+fabs(line[g])))
+                sym=0;
+        }
+    }
+    MPI_Allreduce(&sym,&all,1,MPI_INT,MPI_MIN,MPI_COMM_WORLD);
+    return all;
+}
+
+
+int main (int argc, char * argv[]) {
+    int rank,size;
+#ifdef _OPENMP
+    //Hybrid build: only the master thread talks to MPI
+    int provided;
+    MPI_Init_thread(&argc,&argv,MPI_THREAD_FUNNELED,&provided);
+    if (provided<MPI_THREAD_FUNNELED) {
+        fprintf(stderr,"The MPI library does not support MPI_THREAD_FUNNELED!\n");
+        MPI_Abort(MPI_COMM_WORLD,-1);
+    }
+#else
+    MPI_Init(&argc,&argv);
+#endif
+    MPI_Comm_size(MPI_COMM_WORLD,&size);
+    MPI_Comm_rank(MPI_COMM_WORLD,&rank);
+    char * filename="output_chol_cyclic";
+
+    int X,x,i,k,g,i0,t,fail=-1,spd=1;
+    double ** localA,* temp_line,d;
+    X=input_size(argv[1]);
+    int nrhs=env_int("NRHS",0);
+    int check=env_int("SPD_CHECK",0);
+    double ** localA0=NULL;
+    bench_t bench;
+    int run,runs,threads=1;
+    temp_line=(double*)malloc(X*sizeof(double));
+
+    //Local rows, ranks past X%size hold a ghost row if X%size!=0
+    x=(X+size-1)/size;
+
+    //A matrix file is read as it is, every rank makes its rows of a random
+    //SPD array
+    localA=malloc2D(x,X);
+    if (input_is_file(argv[1]))
+        input_rows(argv[1],localA,x,X,X,DIST_CYCLIC,filename,MPI_COMM_WORLD);
+    else
+        random_rows(localA,x,X,X,DIST_CYCLIC,RAND_SPD,MPI_COMM_WORLD);
+    if (check && !symmetric_rows(localA,x,X,temp_line,rank,size)) {
+        if (rank==0)
+            printf("LU-Cholesky-cyclic\tInput is not symmetric, using LU\n");
+        spd=0;
+    }
+
+    //Keep the original rows to check the solve stage, to restart benchmark
+    //runs and to fall back to LU
+    bench_init(&bench);
+    runs=bench_runs(&bench);
+    if (nrhs>0 || runs>1 || check) {
+        localA0=malloc2D(x,X);
+        copy2D(localA0,localA,x,X);
+    }
+
+    //Timers
+    struct timeval ts,tf,time1,time2;
+    double total_time=0,computation_time=0,communication_time=0,run_time;
+
+    for (run=0;run<runs;run++) {
+        //Every benchmark run starts again from the original rows
+        if (run>0)
+            copy2D(localA,localA0,x,X);
+        communication_time=0;
+        MPI_Barrier(MPI_COMM_WORLD);
+        gettimeofday(&ts,NULL);
+
+        if (spd) {
+            for (k=0;k<X;k++) {
+                MPI_Pcontrol(TRACE_STEP,k);
+                if (rank==k%size) {
+                    double * row=localA[k/size];
+                    d=row[k];
+                    if (d>0) {
+                        d=sqrt(d);
+                        row[k]=d;
+                        d=1.0/d;
+                        for (t=k+1;t<X;t++)
+                            row[t]*=d;
+                    }
+                    for (t=k;t<X;t++)
+                        temp_line[t]=row[t];
+                }
+                gettimeofday(&time1,NULL);
+                MPI_Bcast(&temp_line[k],X-k,MPI_DOUBLE,k%size,MPI_COMM_WORLD);
+                gettimeofday(&time2,NULL);
+                communication_time+=time2.tv_sec-time1.tv_sec+(time2.tv_usec-time1.tv_usec)*0.000001;
+                if (!(temp_line[k]>0)) {
+                    fail=k;
+                    break;
+                }
+
+                //Local rows after row k, ghost rows are skipped
+                i0=k<rank ? 0 : (k-rank)/size+1;
+#ifdef _OPENMP
+                #pragma omp parallel for private(g) schedule(static)
+#endif
+                for (i=i0;i<x;i++) {
+                    g=i*size+rank;
+                    if (g<X)
+                        axpy_row(&localA[i][g],&temp_line[g],temp_line[g],X-g);
+                }
+            }
+            if (fail>=0) {
+                if (!check) {
+                    if (rank==0)
+                        fprintf(stderr,"LU-Cholesky-cyclic: pivot %d is not positive, the matrix is not SPD (SPD_CHECK=1 falls back to LU)\n",fail);
+                    MPI_Abort(MPI_COMM_WORLD,-1);
+                }
+                spd=0;
+                copy2D(localA,localA0,x,X);
+            }
+        }
+
+        //LU with the rows broadcast as in LU_cyclic_bcast
+        if (!spd) {
+            for (k=0;k<X-1;k++) {
+                MPI_Pcontrol(TRACE_STEP,k);
+                if (rank==k%size)
+                    for (t=0;t<X;t++)
+                        temp_line[t]=localA[k/size][t];
+                gettimeofday(&time1,NULL);
+                MPI_Bcast(temp_line,X,MPI_DOUBLE,k%size,MPI_COMM_WORLD);
+                gettimeofday(&time2,NULL);
+                communication_time+=time2.tv_sec-time1.tv_sec+(time2.tv_usec-time1.tv_usec)*0.000001;
+                i0=k<rank ? 0 : (k-rank)/size+1;
+#ifdef _OPENMP
+                #pragma omp parallel for private(g) schedule(static)
+#endif
+                for (i=i0;i<x;i++) {
+                    g=i*size+rank;
+                    if (g<X)
+                        eliminate_row(localA[i],temp_line,k,X);
+                }
+            }
+        }
+
+        MPI_Pcontrol(TRACE_STEP,-1);
+        gettimeofday(&tf,NULL);
+        total_time=tf.tv_sec-ts.tv_sec+(tf.tv_usec-ts.tv_usec)*0.000001;
+        computation_time=total_time-communication_time;
+        MPI_Reduce(&total_time,&run_time,1,MPI_DOUBLE,MPI_MAX,0,MPI_COMM_WORLD);
+        bench_time(&bench,run,run_time);
+    }
+
+    double avg_total,avg_comp,avg_comm,max_total,max_comp,max_comm;
+    MPI_Reduce(&total_time,&max_total,1,MPI_DOUBLE,MPI_MAX,0,MPI_COMM_WORLD);
+    MPI_Reduce(&computation_time,&max_comp,1,MPI_DOUBLE,MPI_MAX,0,MPI_COMM_WORLD);
+    MPI_Reduce(&communication_time,&max_comm,1,MPI_DOUBLE,MPI_MAX,0,MPI_COMM_WORLD);
+    MPI_Reduce(&total_time,&avg_total,1,MPI_DOUBLE,MPI_SUM,0,MPI_COMM_WORLD);
+    MPI_Reduce(&computation_time,&avg_comp,1,MPI_DOUBLE,MPI_SUM,0,MPI_COMM_WORLD);
+    MPI_Reduce(&communication_time,&avg_comm,1,MPI_DOUBLE,MPI_SUM,0,MPI_COMM_WORLD);
+
+    avg_total/=size;
+    avg_comp/=size;
+    avg_comm/=size;
+#ifdef _OPENMP
+    threads=omp_get_max_threads();
+#endif
+
+    if (rank==0) {
+        if (fail>=0)
+            printf("LU-Cholesky-cyclic\tPivot %d is not positive, fell back to LU\n",fail);
+        printf("LU-Cholesky-cyclic\tArray Size\t%d\tProcesses\t%d\n",X,size);
+        printf("Max time:\tTotal\t%lf\tComputation\t%lf\tCommunication\t%lf\n",max_total,max_comp,max_comm);
+        printf("Avg time:\tTotal\t%lf\tComputation\t%lf\tCommunication\t%lf\n",avg_total,avg_comp,avg_comm);
+        bench_report_flops(&bench,"LU-Cholesky-cyclic",X,size,threads,spd ? (double)X*X*X/3.0 : 2.0*X*X*X/3.0);
+    }
+
+    //U in the upper triangle, the lower triangle keeps A (or L and U after LU)
+    output_rows(localA,x,X,X,DIST_CYCLIC,filename,MPI_COMM_WORLD);
+
+    //Solve for a batch of NRHS right-hand sides with the distributed factors
+    if (nrhs>0) {
+        double ** localB=malloc2D(x,nrhs), ** localB0=malloc2D(x,nrhs);
+        random_rows(localB,x,X,nrhs,DIST_CYCLIC,RAND_RHS,MPI_COMM_WORLD);
+        copy2D(localB0,localB,x,nrhs);
+        MPI_Barrier(MPI_COMM_WORLD);
+        gettimeofday(&ts,NULL);
+        if (spd)
+            communication_time=solve_chol_dist(localA,x,X,localB,nrhs,DIST_CYCLIC,MPI_COMM_WORLD);
+        else
+            communication_time=solve_dist(localA,x,X,localB,nrhs,DIST_CYCLIC,MPI_COMM_WORLD);
+        gettimeofday(&tf,NULL);
+        total_time=tf.tv_sec-ts.tv_sec+(tf.tv_usec-ts.tv_usec)*0.000001;
+        double residual=residual_dist(localA0,localB,localB0,x,X,nrhs,DIST_CYCLIC,MPI_COMM_WORLD);
+        MPI_Reduce(&total_time,&max_total,1,MPI_DOUBLE,MPI_MAX,0,MPI_COMM_WORLD);
+        MPI_Reduce(&communication_time,&max_comm,1,MPI_DOUBLE,MPI_MAX,0,MPI_COMM_WORLD);
+        if (rank==0)
+            printf("LU-Cholesky-cyclic-Solve\tRHS\t%d\tMax time:\tTotal\t%lf\tCommunication\t%lf\tResidual\t%e\n",nrhs,max_total,max_comm,residual);
+        free2D(localB,x,nrhs);
+        free2D(localB0,x,nrhs);
+    }
+    if (localA0!=NULL)
+        free2D(localA0,x,X);
+    free2D(localA,x,X);
+    free(temp_line);
+
+    MPI_Finalize();
+
+    return 0;
+}
@@ -15,120 +15,227 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <mpi.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 #include <sys/time.h>
 #include "utils.h"
+#include "mpi_utils.h"
 
 
 int main (int argc, char * argv[]) {
     int rank,size;
+#ifdef _OPENMP
+    //Hybrid build: only the master thread talks to MPI
+    int provided;
+    MPI_Init_thread(&argc,&argv,MPI_THREAD_FUNNELED,&provided);
+    if (provided<MPI_THREAD_FUNNELED) {
+        fprintf(stderr,"The MPI library does not support MPI_THREAD_FUNNELED!\n");
+        MPI_Abort(MPI_COMM_WORLD,-1);
+    }
+#else
     MPI_Init(&argc,&argv);
+#endif
     MPI_Comm_size(MPI_COMM_WORLD,&size);
     MPI_Comm_rank(MPI_COMM_WORLD,&rank);
     MPI_Status status;
-    FILE *fp;
     char * filename="output_cyclic_bcast";
 
 
-    int X,Y,x,y,X_ext,i,j,k,thread,initial,t,count,help;
-    double ** A, ** localA,*temp_line,l;
-    X=atoi(argv[1]);
+    int X,Y,x,y,i,j,k,thread,initial,t,count,help;
+    int depth,nbuf,g,next,slot,last;
+    double ** localA,*temp_line,** lines,* pivot,* line;
+    MPI_Request * reqs;
+    X=input_size(argv[1]);
     Y=X;
+    //Number of right-hand sides to solve for after the factorization
+    int nrhs=env_int("NRHS",0);
+    int verify=env_int("VERIFY",0);
+    double ** localA0=NULL;
+    //Warmup and timed runs of the benchmark mode
+    bench_t bench;
+    int run,runs,threads=1;
+    //Number of pivot-row broadcasts allowed in flight, 0 disables lookahead
+    depth=0;
+    if (argc>2)
+        depth=atoi(argv[2]);
+    if (depth<0)
+        depth=0;
     temp_line=(double*)malloc(Y*sizeof(double));
 
-    //Extend dimension X with ghost cells if X%size!=0
-    if (X%size!=0)
-        X_ext=X+size-X%size;
-    else
-        X_ext=X;
       
 
-    if (rank==0) {
-        //Allocate and init matrix A
-        A=malloc2D(X_ext,Y);
-        init2D(A,X,Y);
-	fp = fopen("output_cyclic_bcast","w");
-        fprintf(fp,"\n****Initial Array****\n");
-        fclose(fp);
-        print2DFile(A,X,Y,filename);
-
-    }
     //Local dimensions x,y
-    x=X_ext/size;
+    x=(X+size-1)/size;
     y=Y;
 
-    //Allocate local matrix and scatter global matrix
+    //Allocate local matrix, every rank reads its own rows of a matrix
+    //file or makes its own rows of a random array
     localA=malloc2D(x,y);
-    double * idx;
-    for (i=0;i<x;i++) {
-        if (rank==0)
-            idx=&A[i*size][0];
-        MPI_Scatter(idx,Y,MPI_DOUBLE,&localA[i][0],y,MPI_DOUBLE,0,MPI_COMM_WORLD);
+    input_rows(argv[1],localA,x,X,Y,DIST_CYCLIC,filename,MPI_COMM_WORLD);
+    //Keep the original rows to check the factors and the solve stage and to
+    //restart benchmark runs
+    bench_init(&bench);
+    runs=bench_runs(&bench);
+    if (nrhs>0 || runs>1 || verify) {
+        localA0=malloc2D(x,y);
+        copy2D(localA0,localA,x,y);
     }
-    if (rank==0)
-        free2D(A,X_ext,Y);
  
     //Timers   
-    struct timeval ts,tf,time1,time2;
-    double total_time=0,computation_time=0,communication_time=0;
-
-	MPI_Barrier(MPI_COMM_WORLD);
-    gettimeofday(&ts,NULL);        
+    struct timeval ts,tf,time1,time2,time3,time4;
+    double total_time=0,computation_time=0,communication_time=0,threaded_time=0,run_time;
 
-	for (k=0;k<X-1;k++){
-        if(rank == (k % size)){                         
-            for(t=0;t < Y;t++)      
-                temp_line[t] = localA[k / size][t];
-        }
-        gettimeofday(&time1,NULL);
-		MPI_Bcast(temp_line,Y, MPI_DOUBLE,  (k % size), MPI_COMM_WORLD);
-		gettimeofday(&time2,NULL);
-		communication_time+=time2.tv_sec-time1.tv_sec+(time2.tv_usec-time1.tv_usec)*0.000001;
-        if (k < ((X-size)+rank) ){       
-
-            if(k < rank ){             
-               initial = 0;
-            }
-            else{                                  
+    for (run=0;run<runs;run++) {
+        //Every benchmark run starts again from the original rows
+        if (run>0)
+            copy2D(localA,localA0,x,y);
+        communication_time=0;
+        threaded_time=0;
+        MPI_Barrier(MPI_COMM_WORLD);
+        gettimeofday(&ts,NULL);        
 
-                if(rank <= (k % size) ){
-                    help = 1;
+        if (depth==0) {
+            for (k=0;k<X-1;k++){
+                MPI_Pcontrol(TRACE_STEP,k);
+                if(rank == (k % size)){                         
+                    for(t=0;t < Y;t++)      
+                        temp_line[t] = localA[k / size][t];
                 }
-                else{
-                    help = 0;
+                gettimeofday(&time1,NULL);
+                MPI_Bcast(temp_line,Y, MPI_DOUBLE,  (k % size), MPI_COMM_WORLD);
+                gettimeofday(&time2,NULL);
+                communication_time+=time2.tv_sec-time1.tv_sec+(time2.tv_usec-time1.tv_usec)*0.000001;
+                //Only if row k is above the last local row
+                if (k < (x-1)*size+rank){
+
+                    if(k < rank ){             
+                       initial = 0;
+                    }
+                    else{                                  
+
+                        if(rank <= (k % size) ){
+                            help = 1;
+                        }
+                        else{
+                            help = 0;
+                        }
+                        initial = ((k / size ) + help);
+                    }
+                    gettimeofday(&time3,NULL);
+#ifdef _OPENMP
+                    #pragma omp parallel for schedule(static)
+#endif
+                    for(i= initial ;i<x ;i++){
+
+                        if( rank != (k % size) ){               
+                            eliminate_row(localA[i],temp_line,k,X);
+                        }
+                        else{           
+                            eliminate_row(localA[i],localA[k / size],k,X);
+                        }
+                    }
+                    gettimeofday(&time4,NULL);
+                    threaded_time+=time4.tv_sec-time3.tv_sec+(time4.tv_usec-time3.tv_usec)*0.000001;
                 }
-                initial = ((k / size ) + help);
             }
-            for(i= initial ;i<x ;i++){
-
-                if( rank != (k % size) ){               
-                    l = localA[i][k] / temp_line[k];
+        }
+        else {
+            //Lookahead of depth d: at step k the owner of row k+d applies the
+            //pivots it still misses to that row and posts its broadcast, so
+            //the broadcasts of the next d pivot rows are in flight while the
+            //rest of step k runs. Rows up to k+d are left out of the update of
+            //step k, they already have that pivot.
+            nbuf=depth+1;
+            lines=malloc2D(nbuf,Y);
+            reqs=(MPI_Request *)malloc(nbuf*sizeof(MPI_Request));
+            for (t=0;t<nbuf;t++)
+                reqs[t]=MPI_REQUEST_NULL;
 
-                    for(j=k;j<X;j++){
-                        localA[i][j] = localA[i][j]-l*temp_line[j];
+            //The first d steps only post rows 0..d-1
+            for(k=-depth;k<X-1;k++){
+                if(k >= 0){
+                    MPI_Pcontrol(TRACE_STEP,k);
+                    slot=k%nbuf;
+                    if(rank == (k % size)){
+                        pivot=localA[k / size];
+                    }
+                    else{
+                        gettimeofday(&time1,NULL);
+                        MPI_Wait(&reqs[slot],MPI_STATUS_IGNORE);
+                        gettimeofday(&time2,NULL);
+                        communication_time+=time2.tv_sec-time1.tv_sec+(time2.tv_usec-time1.tv_usec)*0.000001;
+                        pivot=lines[slot];
                     }
                 }
-                else{           
-                    l = localA[i][k] / localA[k / size][k];
-                    for(j=k;j<X;j++){
-                        localA[i][j] = localA[i][j]-l*localA[k / size][j];
+
+                //Row k+d gets pivots k..k+d-1, whose broadcasts were posted
+                //in the previous steps, then its own broadcast is posted
+                next=k+depth;
+                if(next < X-1){
+                    if(rank == (next % size)){
+                        i=next / size;
+                        for(j=(k > 0 ? k : 0);j<next;j++){
+                            if(rank == (j % size)){
+                                line=localA[j / size];
+                            }
+                            else{
+                                gettimeofday(&time1,NULL);
+                                MPI_Wait(&reqs[j%nbuf],MPI_STATUS_IGNORE);
+                                gettimeofday(&time2,NULL);
+                                communication_time+=time2.tv_sec-time1.tv_sec+(time2.tv_usec-time1.tv_usec)*0.000001;
+                                line=lines[j%nbuf];
+                            }
+                            eliminate_row(localA[i],line,j,X);
+                        }
+                    }
+                    slot=next%nbuf;
+                    gettimeofday(&time1,NULL);
+                    MPI_Wait(&reqs[slot],MPI_STATUS_IGNORE);
+                    if(rank == (next % size)){
+                        for(t=0;t < Y;t++)
+                            lines[slot][t] = localA[next / size][t];
                     }
+                    MPI_Ibcast(lines[slot],Y,MPI_DOUBLE,(next % size),MPI_COMM_WORLD,&reqs[slot]);
+                    gettimeofday(&time2,NULL);
+                    communication_time+=time2.tv_sec-time1.tv_sec+(time2.tv_usec-time1.tv_usec)*0.000001;
                 }
+                if(k < 0)
+                    continue;
+
+                //Rest of step k while the broadcasts are in flight, the last
+                //row is never broadcast and always updated here
+                last=(next < X-1 ? next : X-2);
+                gettimeofday(&time3,NULL);
+#ifdef _OPENMP
+                #pragma omp parallel for private(g) schedule(static)
+#endif
+                for(i=0;i<x;i++){
+                    g=i*size+rank;
+                    if(g <= last || g >= X)
+                        continue;
+                    eliminate_row(localA[i],pivot,k,X);
+                }
+                gettimeofday(&time4,NULL);
+                threaded_time+=time4.tv_sec-time3.tv_sec+(time4.tv_usec-time3.tv_usec)*0.000001;
             }
-        }
-    }
 
-    gettimeofday(&tf,NULL);
-    total_time=tf.tv_sec-ts.tv_sec+(tf.tv_usec-ts.tv_usec)*0.000001;
-    computation_time=total_time-communication_time;
+            gettimeofday(&time1,NULL);
+            MPI_Waitall(nbuf,reqs,MPI_STATUSES_IGNORE);
+            gettimeofday(&time2,NULL);
+            communication_time+=time2.tv_sec-time1.tv_sec+(time2.tv_usec-time1.tv_usec)*0.000001;
+            free2D(lines,nbuf,Y);
+            free(reqs);
+        }
 
-    //Gather local matrices back to the global matrix
-    if (rank==0) 
-        A=malloc2D(X_ext,Y);
-    for (i=0;i<x;i++) {
-        if (rank==0)
-            idx=&A[i*size][0];
-        MPI_Gather(&localA[i][0],y,MPI_DOUBLE,idx,Y,MPI_DOUBLE,0,MPI_COMM_WORLD);
+        MPI_Pcontrol(TRACE_STEP,-1);
+        gettimeofday(&tf,NULL);
+        total_time=tf.tv_sec-ts.tv_sec+(tf.tv_usec-ts.tv_usec)*0.000001;
+        computation_time=total_time-communication_time;
+        MPI_Reduce(&total_time,&run_time,1,MPI_DOUBLE,MPI_MAX,0,MPI_COMM_WORLD);
+        bench_time(&bench,run,run_time);
     }
+
     MPI_Barrier(MPI_COMM_WORLD);
     
     double avg_total,avg_comp,avg_comm,max_total,max_comp,max_comm;
@@ -138,23 +245,71 @@ int main (int argc, char * argv[]) {
     MPI_Reduce(&total_time,&avg_total,1,MPI_DOUBLE,MPI_SUM,0,MPI_COMM_WORLD);
     MPI_Reduce(&computation_time,&avg_comp,1,MPI_DOUBLE,MPI_SUM,0,MPI_COMM_WORLD);
     MPI_Reduce(&communication_time,&avg_comm,1,MPI_DOUBLE,MPI_SUM,0,MPI_COMM_WORLD);
+#ifdef _OPENMP
+    double avg_thr,max_thr;
+    MPI_Reduce(&threaded_time,&max_thr,1,MPI_DOUBLE,MPI_MAX,0,MPI_COMM_WORLD);
+    MPI_Reduce(&threaded_time,&avg_thr,1,MPI_DOUBLE,MPI_SUM,0,MPI_COMM_WORLD);
+    avg_thr/=size;
+#endif
 
     avg_total/=size;
     avg_comp/=size;
     avg_comm/=size;
 
     if (rank==0) {
-        printf("LU-Cyclic-bcast\tArray Size\t%d\tProcesses\t%d\n",X,size);
+        if (depth>0)
+            printf("LU-Cyclic-bcast\tArray Size\t%d\tProcesses\t%d\tLookahead\t%d\n",X,size,depth);
+        else
+            printf("LU-Cyclic-bcast\tArray Size\t%d\tProcesses\t%d\n",X,size);
         printf("Max time:\tTotal\t%lf\tComputation\t%lf\tCommunication\t%lf\n",max_total,max_comp,max_comm);
         printf("Avg time:\tTotal\t%lf\tComputation\t%lf\tCommunication\t%lf\n",avg_total,avg_comp,avg_comm);
+#ifdef _OPENMP
+        printf("Threads per process\t%d\tThreaded computation:\tMax\t%lf\tAvg\t%lf\n",omp_get_max_threads(),max_thr,avg_thr);
+#endif
     }
 
-    if (rank==0) {
-        fp = fopen("output_cyclic_bcast","a");
-        fprintf(fp,"\n****Final Array****\n");
-        fclose(fp);
-        print2DFile(A,X,Y,filename);
+#ifdef _OPENMP
+    threads=omp_get_max_threads();
+#endif
+    if (rank==0)
+        bench_report(&bench,"LU-Cyclic-bcast",X,size,threads);
+
+    //Write triangular matrix U and the multipliers
+    output_rows(localA,x,X,Y,DIST_CYCLIC,filename,MPI_COMM_WORLD);
+
+    //Check the factors against the original rows
+    if (verify) {
+        MPI_Barrier(MPI_COMM_WORLD);
+        gettimeofday(&ts,NULL);
+        double residual=verify_dist(localA0,localA,x,X,DIST_CYCLIC,MPI_COMM_WORLD);
+        gettimeofday(&tf,NULL);
+        total_time=tf.tv_sec-ts.tv_sec+(tf.tv_usec-ts.tv_usec)*0.000001;
+        if (rank==0)
+            verify_report("LU-Cyclic-bcast",residual,total_time);
+    }
+    //Solve for a batch of NRHS right-hand sides with the distributed factors
+    if (nrhs>0) {
+        double ** localB=malloc2D(x,nrhs), ** localB0=malloc2D(x,nrhs);
+        random_rows(localB,x,X,nrhs,DIST_CYCLIC,RAND_RHS,MPI_COMM_WORLD);
+        for (i=0;i<x;i++)
+            for (j=0;j<nrhs;j++)
+                localB0[i][j]=localB[i][j];
+        MPI_Barrier(MPI_COMM_WORLD);
+        gettimeofday(&ts,NULL);
+        communication_time=solve_dist(localA,x,X,localB,nrhs,DIST_CYCLIC,MPI_COMM_WORLD);
+        gettimeofday(&tf,NULL);
+        total_time=tf.tv_sec-ts.tv_sec+(tf.tv_usec-ts.tv_usec)*0.000001;
+        double residual=residual_dist(localA0,localB,localB0,x,X,nrhs,DIST_CYCLIC,MPI_COMM_WORLD);
+        MPI_Reduce(&total_time,&max_total,1,MPI_DOUBLE,MPI_MAX,0,MPI_COMM_WORLD);
+        MPI_Reduce(&communication_time,&max_comm,1,MPI_DOUBLE,MPI_MAX,0,MPI_COMM_WORLD);
+        if (rank==0)
+            printf("LU-Cyclic-bcast-Solve\tRHS\t%d\tMax time:\tTotal\t%lf\tCommunication\t%lf\tResidual\t%e\n",nrhs,max_total,max_comm,residual);
+        free2D(localB,x,nrhs);
+        free2D(localB0,x,nrhs);
     }
+    if (localA0!=NULL)
+        free2D(localA0,x,y);
+
     MPI_Finalize();
 
     return 0;
@@ -0,0 +1,235 @@
+/**************************************************
+# Copyright (C) 2014 Raptis Dimos <raptis.dimos@yahoo.gr>
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+# **************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <float.h>
+#include <sys/time.h>
+#include "utils.h"
+
+//Mixed precision LU: A is factored in single precision, then the solution
+//of A*X=B is refined in double. Every step computes R=B-A*X in double,
+//solves A*D=R with the single precision factors and adds D to X.
+
+//Default panel width and column tile of the blocked factorization
+#define PANEL 64
+#define TILE 256
+//Refinement stops once the scaled residual is within N*DBL_EPSILON, the
+//accuracy of the double path. When it stops falling by half a step, or after
+//ITER_MAX steps, the system is solved in double instead (as LAPACK dsgesv)
+#define ITER_MAX 30
+
+#define MIN(a,b) ((a)<(b)?(a):(b))
+
+//Blocked right-looking LU, the same loops as LU_blocked
+static void factor(double ** A, int X, int Y, int nb) {
+    int i,k,p,kb,kend,jj,jend;
+    for (kb=0;kb<X-1;kb+=nb) {
+        kend=MIN(kb+nb,X);
+        for (k=kb;k<kend;k++)
+            for (i=k+1;i<X;i++)
+                eliminate_row(A[i],A[k],k,kend);
+        for (k=kb;k<kend;k++)
+            for (i=k+1;i<kend;i++)
+                axpy_row(&A[i][kend],&A[k][kend],A[i][k],Y-kend);
+        for (jj=kend;jj<Y;jj+=TILE) {
+            jend=MIN(jj+TILE,Y);
+            for (i=kend;i<X;i++)
+                for (p=kb;p<kend;p++)
+                    axpy_row(&A[i][jj],&A[p][jj],A[i][p],jend-jj);
+        }
+    }
+}
+
+//Single precision copy, a column tile of the same size in bytes holds
+//twice the columns
+static void factorf(float ** A, int X, int Y, int nb) {
+    int i,k,p,kb,kend,jj,jend;
+    for (kb=0;kb<X-1;kb+=nb) {
+        kend=MIN(kb+nb,X);
+        for (k=kb;k<kend;k++)
+            for (i=k+1;i<X;i++)
+                eliminate_rowf(A[i],A[k],k,kend);
+        for (k=kb;k<kend;k++)
+            for (i=k+1;i<kend;i++)
+                axpy_rowf(&A[i][kend],&A[k][kend],A[i][k],Y-kend);
+        for (jj=kend;jj<Y;jj+=2*TILE) {
+            jend=MIN(jj+2*TILE,Y);
+            for (i=kend;i<X;i++)
+                for (p=kb;p<kend;p++)
+                    axpy_rowf(&A[i][jj],&A[p][jj],A[i][p],jend-jj);
+        }
+    }
+}
+
+//Solve LU*D=R with the single precision factors, D overwrites R
+static void solvef(float ** LU, int N, float ** R, int nrhs) {
+    int i,j,p;
+    float l;
+    for (i=1;i<N;i++)
+        for (p=0;p<i;p++) {
+            l=LU[i][p];
+            for (j=0;j<nrhs;j++)
+                R[i][j]-=l*R[p][j];
+        }
+    for (i=N-1;i>=0;i--) {
+        for (p=i+1;p<N;p++) {
+            l=LU[i][p];
+            for (j=0;j<nrhs;j++)
+                R[i][j]-=l*R[p][j];
+        }
+        l=1.0f/LU[i][i];
+        for (j=0;j<nrhs;j++)
+            R[i][j]*=l;
+    }
+}
+
+//R=B-A*X in double, R is also kept in single precision for the solve.
+//Returns the scaled residual max|R|/(max|A|*max|X|*N) of residual2D.
+static double residual(double ** A, double ** X, double ** B, float ** R, int N, int nrhs, double amax) {
+    int i,j,p;
+    double r,rmax=0,xmax=0;
+    double * row=malloc(nrhs*sizeof(double));
+    if (row==NULL) {
+        fprintf(stderr,"Malloc failed!\n");
+        exit(-1);
+    }
+    for (i=0;i<N;i++) {
+        for (j=0;j<nrhs;j++) {
+            row[j]=B[i][j];
+            if (fabs(X[i][j])>xmax)
+                xmax=fabs(X[i][j]);
+        }
+        for (p=0;p<N;p++)
+            for (j=0;j<nrhs;j++)
+                row[j]-=A[i][p]*X[p][j];
+        for (j=0;j<nrhs;j++) {
+            R[i][j]=row[j];
+            r=fabs(row[j]);
+            if (r>rmax)
+                rmax=r;
+        }
+    }
+    free(row);
+    if (amax==0 || xmax==0)
+        return rmax;
+    return rmax/(amax*xmax*N);
+}
+
+
+int main(int argc, char * argv[])
+{
+    int X=input_size(argv[1]);
+    int Y=X;
+    int nb=PANEL;
+    if (argc>2)
+        nb=atoi(argv[2]);
+    if (nb<1)
+        nb=1;
+    double ** A=malloc2D(X,Y);
+    input2D(A,X,Y,argv[1]);
+    int i,j,iter=0,fallback=0;
+    struct timeval ts,tf;
+    double total_time=0,double_time=0,res=0,prev,amax=0;
+
+    //Refinement needs a right-hand side, solve for one unless NRHS asks for more
+    int nrhs=env_int("NRHS",1);
+    if (nrhs<1)
+        nrhs=1;
+    double ** B=malloc2D(X,nrhs), ** Xs=malloc2D(X,nrhs), ** Xd=malloc2D(X,nrhs), ** Ad=malloc2D(X,Y);
+    float ** Af=malloc2Df(X,Y), ** R=malloc2Df(X,nrhs);
+    init2DRHS(B,X,nrhs);
+    for (i=0;i<X;i++)
+        for (j=0;j<Y;j++)
+            if (fabs(A[i][j])>amax)
+                amax=fabs(A[i][j]);
+
+    bench_t bench;
+    bench_init(&bench);
+    int run,runs=bench_runs(&bench);
+
+    for (run=0;run<runs;run++) {
+        //Pure double path: factor a copy of A and solve
+        copy2D(Ad,A,X,Y);
+        copy2D(Xd,B,X,nrhs);
+        gettimeofday(&ts,NULL);
+        factor(Ad,X,Y,nb);
+        solve2D(Ad,X,Xd,0,nrhs);
+        gettimeofday(&tf,NULL);
+        double_time=(tf.tv_sec-ts.tv_sec)+(tf.tv_usec-ts.tv_usec)*0.000001;
+
+        //Mixed path: factor in single precision, first solution from the
+        //single precision factors, then refine in double
+        gettimeofday(&ts,NULL);
+        for (i=0;i<X;i++)
+            for (j=0;j<Y;j++)
+                Af[i][j]=A[i][j];
+        factorf(Af,X,Y,nb);
+        for (i=0;i<X;i++)
+            for (j=0;j<nrhs;j++) {
+                R[i][j]=B[i][j];
+                Xs[i][j]=0;
+            }
+        prev=DBL_MAX;
+        fallback=0;
+        for (iter=0;;iter++) {
+            solvef(Af,X,R,nrhs);
+            for (i=0;i<X;i++)
+                for (j=0;j<nrhs;j++)
+                    Xs[i][j]+=R[i][j];
+            res=residual(A,Xs,B,R,X,nrhs,amax);
+            if (res<=X*DBL_EPSILON)
+                break;
+            if (res>=prev/2 || iter+1>=ITER_MAX) {
+                fallback=1;
+                break;
+            }
+            prev=res;
+        }
+        //No convergence: factor and solve in double, the time counts
+        if (fallback) {
+            copy2D(Ad,A,X,Y);
+            copy2D(Xs,B,X,nrhs);
+            factor(Ad,X,Y,nb);
+            solve2D(Ad,X,Xs,0,nrhs);
+            res=residual2D(A,Xs,B,X,nrhs);
+        }
+        gettimeofday(&tf,NULL);
+        total_time=(tf.tv_sec-ts.tv_sec)+(tf.tv_usec-ts.tv_usec)*0.000001;
+        bench_time(&bench,run,total_time);
+    }
+    if (fallback)
+        printf("LU-Mixed\t%d\t%d\t%.3lf\tIterations\t%d\tResidual\t%e\tFallback\tdouble\n",X,nrhs,total_time,iter+1,res);
+    else
+        printf("LU-Mixed\t%d\t%d\t%.3lf\tIterations\t%d\tResidual\t%e\n",X,nrhs,total_time,iter+1,res);
+    printf("LU-Double\t%d\t%d\t%.3lf\tResidual\t%e\n",X,nrhs,double_time,residual2D(A,Xd,B,X,nrhs));
+    //A run that fell back did the double solve too, there is no speedup
+    if (!fallback)
+        printf("Speedup\t%.2lf\n",total_time>0 ? double_time/total_time : 0);
+    bench_report(&bench,"LU-Mixed",X,1,1);
+
+    //The refined solution, or the double one after a fallback
+    char * filename="output_mixed";
+    output2D(Xs,X,nrhs,filename);
+
+    free2D(A,X,Y);
+    free2D(Ad,X,Y);
+    free2D(B,X,nrhs);
+    free2D(Xs,X,nrhs);
+    free2D(Xd,X,nrhs);
+    free2Df(Af,X,Y);
+    free2Df(R,X,nrhs);
+	return 0;
+}
@@ -0,0 +1,211 @@
+/**************************************************
+# Copyright (C) 2014 Raptis Dimos <raptis.dimos@yahoo.gr>
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+# **************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <omp.h>
+#include "utils.h"
+
+//Default tile size
+#define TILE 128
+
+//Task priorities, only honoured when OMP_MAX_TASK_PRIORITY>=PRIO_DIAG.
+//The diagonal tile and the next panel are on the critical path.
+#define PRIO_DIAG 2
+#define PRIO_PANEL 1
+#define PRIO_UPDATE 0
+
+#define MIN(a,b) ((a)<(b)?(a):(b))
+
+//Factor the diagonal tile in place, multipliers kept below the diagonal
+static void tile_getrf(double ** A, int K, int Kend) {
+    int i,k;
+    for (k=K;k<Kend;k++)
+        for (i=k+1;i<Kend;i++)
+            eliminate_row(A[i],A[k],k,Kend);
+}
+
+//Row update: apply the diagonal tile (K) to tile (K,J)
+static void tile_row(double ** A, int K, int Kend, int J, int Jend) {
+    int i,p;
+    for (p=K;p<Kend;p++)
+        for (i=p+1;i<Kend;i++)
+            axpy_row(&A[i][J],&A[p][J],A[i][p],Jend-J);
+}
+
+//Panel factor: compute the multipliers of tile (I,K)
+static void tile_panel(double ** A, int I, int Iend, int K, int Kend) {
+    int i,p;
+    for (i=I;i<Iend;i++)
+        for (p=K;p<Kend;p++)
+            eliminate_row(A[i],A[p],p,Kend);
+}
+
+//Trailing update: tile (I,J) -= tile (I,K) * tile (K,J)
+static void tile_update(double ** A, int I, int Iend, int J, int Jend, int K, int Kend) {
+    int i,p;
+    double *Ai;
+    for (i=I;i<Iend;i++) {
+        Ai=A[i];
+        for (p=K;p<Kend;p++)
+            axpy_row(&Ai[J],&A[p][J],Ai[p],Jend-J);
+    }
+}
+
+
+int main(int argc, char * argv[])
+{
+    int X=input_size(argv[1]);
+    int Y=X;
+    int nb=TILE;
+    if (argc>2)
+        nb=atoi(argv[2]);
+    if (nb<1)
+        nb=1;
+    double ** A=malloc2D(X,Y);
+    input2D(A,X,Y,argv[1]);
+    int i,j,kt,it,jt,nt,threads;
+    long tasks=0;
+    struct timeval ts,tf;
+    double total_time=0;
+
+    //One dependency sentinel per tile
+    nt=(X+nb-1)/nb;
+    char * dep=calloc(nt*nt,sizeof(char));
+    threads=omp_get_max_threads();
+    double * busy=calloc(threads,sizeof(double));
+    if (dep==NULL || busy==NULL) {
+        fprintf(stderr,"Malloc failed!\n");
+        exit(-1);
+    }
+
+    //Keep a copy of A to check the factors and the solve stage and to restart
+    //benchmark runs
+    int nrhs=env_int("NRHS",0);
+    int verify=env_int("VERIFY",0);
+    bench_t bench;
+    bench_init(&bench);
+    int run,runs=bench_runs(&bench);
+    double ** A0=NULL, ** B, ** B0;
+    if (nrhs>0 || runs>1 || verify) {
+        A0=malloc2D(X,Y);
+        copy2D(A0,A,X,Y);
+    }
+
+    for (run=0;run<runs;run++) {
+        //Every benchmark run starts again from the original array
+        if (run>0)
+            copy2D(A,A0,X,Y);
+        tasks=0;
+        for (i=0;i<threads;i++)
+            busy[i]=0;
+        gettimeofday(&ts,NULL);
+        #pragma omp parallel private(kt,it,jt) shared(A,dep,busy,tasks)
+        #pragma omp single
+        for (kt=0;kt<nt;kt++) {
+            int K=kt*nb,Kend=MIN(K+nb,X);
+
+            #pragma omp task firstprivate(K,Kend) depend(inout:dep[kt*nt+kt]) priority(PRIO_DIAG)
+            {
+                double t=omp_get_wtime();
+                tile_getrf(A,K,Kend);
+                busy[omp_get_thread_num()]+=omp_get_wtime()-t;
+            }
+            tasks++;
+
+            for (it=kt+1;it<nt;it++) {
+                int I=it*nb,Iend=MIN(I+nb,X);
+                #pragma omp task firstprivate(I,Iend,K,Kend) depend(in:dep[kt*nt+kt]) depend(inout:dep[it*nt+kt]) priority(PRIO_PANEL)
+                {
+                    double t=omp_get_wtime();
+                    tile_panel(A,I,Iend,K,Kend);
+                    busy[omp_get_thread_num()]+=omp_get_wtime()-t;
+                }
+                tasks++;
+            }
+
+            for (jt=kt+1;jt<nt;jt++) {
+                int J=jt*nb,Jend=MIN(J+nb,Y);
+                #pragma omp task firstprivate(J,Jend,K,Kend) depend(in:dep[kt*nt+kt]) depend(inout:dep[kt*nt+jt]) priority(jt==kt+1?PRIO_PANEL:PRIO_UPDATE)
+                {
+                    double t=omp_get_wtime();
+                    tile_row(A,K,Kend,J,Jend);
+                    busy[omp_get_thread_num()]+=omp_get_wtime()-t;
+                }
+                tasks++;
+            }
+
+            //Updates of the next tile column feed the next panel, so they
+            //get the panel priority and step kt+1 can start early
+            for (it=kt+1;it<nt;it++)
+                for (jt=kt+1;jt<nt;jt++) {
+                    int I=it*nb,Iend=MIN(I+nb,X);
+                    int J=jt*nb,Jend=MIN(J+nb,Y);
+                    #pragma omp task firstprivate(I,Iend,J,Jend,K,Kend) depend(in:dep[it*nt+kt],dep[kt*nt+jt]) depend(inout:dep[it*nt+jt]) priority(jt==kt+1?PRIO_PANEL:PRIO_UPDATE)
+                    {
+                        double t=omp_get_wtime();
+                        tile_update(A,I,Iend,J,Jend,K,Kend);
+                        busy[omp_get_thread_num()]+=omp_get_wtime()-t;
+                    }
+                    tasks++;
+                }
+        }
+        gettimeofday(&tf,NULL);
+        total_time=(tf.tv_sec-ts.tv_sec)+(tf.tv_usec-ts.tv_usec)*0.000001;
+        bench_time(&bench,run,total_time);
+    }
+	printf("LU-OpenMP-Tasks\t%d\t%d\t%.3lf\n",X,nb,total_time);
+    bench_report(&bench,"LU-OpenMP-Tasks",X,1,threads);
+    printf("Tasks\t%ld\tThreads\t%d\n",tasks,threads);
+    for (i=0;i<threads;i++)
+        printf("Thread\t%d\tBusy\t%.3lf\tIdle\t%.3lf\n",i,busy[i],total_time-busy[i]);
+
+    char * filename="output_omp_tasks";
+    output2D(A,X,Y,filename);
+
+    //Check the factors against the original array
+    if (verify) {
+        gettimeofday(&ts,NULL);
+        double residual=verify2D(A0,A,X);
+        gettimeofday(&tf,NULL);
+        total_time=(tf.tv_sec-ts.tv_sec)+(tf.tv_usec-ts.tv_usec)*0.000001;
+        verify_report("LU-OpenMP-Tasks",residual,total_time);
+    }
+
+    //Solve for a batch of NRHS right-hand sides with the factors
+    if (nrhs>0) {
+        B=malloc2D(X,nrhs);
+        B0=malloc2D(X,nrhs);
+        init2DRHS(B,X,nrhs);
+        for (i=0;i<X;i++)
+            for (j=0;j<nrhs;j++)
+                B0[i][j]=B[i][j];
+        gettimeofday(&ts,NULL);
+        #pragma omp parallel
+        {
+            //Right-hand sides are independent, every thread solves a slice
+            int t=omp_get_thread_num(),nt=omp_get_num_threads();
+            solve2D(A,X,B,nrhs*t/nt,nrhs*(t+1)/nt);
+        }
+        gettimeofday(&tf,NULL);
+        total_time=(tf.tv_sec-ts.tv_sec)+(tf.tv_usec-ts.tv_usec)*0.000001;
+        printf("LU-OpenMP-Tasks-Solve\t%d\t%d\t%.3lf\tResidual\t%e\n",X,nrhs,total_time,residual2D(A0,B,B0,X,nrhs));
+        free2D(B,X,nrhs);
+        free2D(B0,X,nrhs);
+    }
+    if (A0!=NULL)
+        free2D(A0,X,Y);
+    return 0;
+}
@@ -0,0 +1,200 @@
+/**************************************************
+# Copyright (C) 2014 Raptis Dimos <raptis.dimos@yahoo.gr>
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+# **************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include "utils.h"
+
+//Built once as lu_recursive and once with openMP as lu_omp_recursive,
+//where the independent halves of every split become tasks
+#ifdef _OPENMP
+#include <omp.h>
+#define OMP(x) _Pragma(#x)
+#else
+#define OMP(x)
+#endif
+
+//Recursion stops at panels of LEAF columns and at products of GEMM_LEAF
+//flops, only to keep the call overhead small: the same cutoffs serve every
+//size and no block size is tuned.
+#define LEAF 32
+#define GEMM_LEAF (256*256*256)
+//Smallest product worth its own task
+#define TASK_MIN (64*64*64)
+
+//C-=A*B for the m x k block A at (ai,aj), the k x n block B at (bi,bj) and
+//the m x n block C at (ci,cj) of the same array. The largest dimension is
+//halved, halves of m or n are independent, halves of k are not.
+static void rgemm(double ** M, int ci, int cj, int ai, int aj, int bi, int bj, int m, int k, int n) {
+    int i,p,h;
+    long flops=(long)m*k*n;
+    if (flops<=GEMM_LEAF) {
+        for (i=0;i<m;i++)
+            for (p=0;p<k;p++)
+                axpy_row(&M[ci+i][cj],&M[bi+p][bj],M[ai+i][aj+p],n);
+        return;
+    }
+    if (m>=k && m>=n) {
+        h=m/2;
+        OMP(omp task if(flops>=TASK_MIN))
+        rgemm(M,ci,cj,ai,aj,bi,bj,h,k,n);
+        rgemm(M,ci+h,cj,ai+h,aj,bi,bj,m-h,k,n);
+        OMP(omp taskwait)
+    }
+    else if (n>=k) {
+        h=n/2;
+        OMP(omp task if(flops>=TASK_MIN))
+        rgemm(M,ci,cj,ai,aj,bi,bj,m,k,h);
+        rgemm(M,ci,cj+h,ai,aj,bi,bj+h,m,k,n-h);
+        OMP(omp taskwait)
+    }
+    else {
+        h=k/2;
+        rgemm(M,ci,cj,ai,aj,bi,bj,m,h,n);
+        rgemm(M,ci,cj,ai,aj+h,bi+h,bj,m,k-h,n);
+    }
+}
+
+//B=L^-1*B for the unit lower n x n block L at (li,lj) and the n x w block
+//B at (bi,bj). Wide right-hand sides are split by columns, which are
+//independent, otherwise L is split into L11, L21 and L22.
+static void rtrsm(double ** M, int li, int lj, int bi, int bj, int n, int w) {
+    int i,p,h;
+    if (n<=LEAF) {
+        for (p=0;p<n;p++)
+            for (i=p+1;i<n;i++)
+                axpy_row(&M[bi+i][bj],&M[bi+p][bj],M[li+i][lj+p],w);
+        return;
+    }
+    if (w>n) {
+        h=w/2;
+        OMP(omp task if((long)n*n*w>=TASK_MIN))
+        rtrsm(M,li,lj,bi,bj,n,h);
+        rtrsm(M,li,lj,bi,bj+h,n,w-h);
+        OMP(omp taskwait)
+    }
+    else {
+        h=n/2;
+        rtrsm(M,li,lj,bi,bj,h,w);
+        rgemm(M,bi+h,bj,li+h,lj,bi,bj,n-h,h,w);
+        rtrsm(M,li+h,lj+h,bi+h,bj,n-h,w);
+    }
+}
+
+//Factor the m x n panel at (r,c), m>=n: factor the left half, solve for
+//the top of the right half, update the rest of it and factor it
+static void rlu(double ** M, int r, int c, int m, int n) {
+    int i,p,h;
+    if (n<=LEAF) {
+        for (p=0;p<n;p++)
+            for (i=p+1;i<n;i++)
+                eliminate_row(M[r+i],M[r+p],c+p,c+n);
+        //The rows below the diagonal block only depend on it
+        OMP(omp taskloop if((long)(m-n)*n*n>=TASK_MIN))
+        for (i=n;i<m;i++)
+            for (p=0;p<n;p++)
+                eliminate_row(M[r+i],M[r+p],c+p,c+n);
+        return;
+    }
+    h=n/2;
+    rlu(M,r,c,m,h);
+    rtrsm(M,r,c,r,c+h,h,n-h);
+    rgemm(M,r+h,c+h,r+h,c,r,c+h,m-h,h,n-h);
+    rlu(M,r+h,c+h,m-h,n-h);
+}
+
+
+int main(int argc, char * argv[])
+{
+    int X=input_size(argv[1]);
+    int Y=X;
+    double ** A=malloc2D(X,Y);
+    input2D(A,X,Y,argv[1]);
+    int threads=1;
+    struct timeval ts,tf;
+    double total_time=0;
+#ifdef _OPENMP
+    char * name="LU-OpenMP-Recursive", * filename="output_omp_recursive";
+    threads=omp_get_max_threads();
+#else
+    char * name="LU-Recursive", * filename="output_recursive";
+#endif
+
+    //Keep a copy of A to check the factors and the solve stage and to restart
+    //benchmark runs
+    int nrhs=env_int("NRHS",0);
+    int verify=env_int("VERIFY",0);
+    bench_t bench;
+    bench_init(&bench);
+    int run,runs=bench_runs(&bench);
+    double ** A0=NULL, ** B, ** B0;
+    if (nrhs>0 || runs>1 || verify) {
+        A0=malloc2D(X,Y);
+        copy2D(A0,A,X,Y);
+    }
+
+    for (run=0;run<runs;run++) {
+        //Every benchmark run starts again from the original array
+        if (run>0)
+            copy2D(A,A0,X,Y);
+        gettimeofday(&ts,NULL);
+        OMP(omp parallel)
+        OMP(omp single)
+        rlu(A,0,0,X,Y);
+        gettimeofday(&tf,NULL);
+        total_time=(tf.tv_sec-ts.tv_sec)+(tf.tv_usec-ts.tv_usec)*0.000001;
+        bench_time(&bench,run,total_time);
+    }
+    printf("%s\t%d\t%.3lf\n",name,X,total_time);
+    bench_report(&bench,name,X,1,threads);
+
+    output2D(A,X,Y,filename);
+
+    //Check the factors against the original array
+    if (verify) {
+        gettimeofday(&ts,NULL);
+        double residual=verify2D(A0,A,X);
+        gettimeofday(&tf,NULL);
+        total_time=(tf.tv_sec-ts.tv_sec)+(tf.tv_usec-ts.tv_usec)*0.000001;
+        verify_report(name,residual,total_time);
+    }
+
+    //Solve for a batch of NRHS right-hand sides with the factors
+    if (nrhs>0) {
+        B=malloc2D(X,nrhs);
+        B0=malloc2D(X,nrhs);
+        init2DRHS(B,X,nrhs);
+        copy2D(B0,B,X,nrhs);
+        gettimeofday(&ts,NULL);
+        OMP(omp parallel)
+        {
+            //Right-hand sides are independent, every thread solves a slice
+            int t=0,nt=1;
+#ifdef _OPENMP
+            t=omp_get_thread_num();
+            nt=omp_get_num_threads();
+#endif
+            solve2D(A,X,B,nrhs*t/nt,nrhs*(t+1)/nt);
+        }
+        gettimeofday(&tf,NULL);
+        total_time=(tf.tv_sec-ts.tv_sec)+(tf.tv_usec-ts.tv_usec)*0.000001;
+        printf("%s-Solve\t%d\t%d\t%.3lf\tResidual\t%e\n",name,X,nrhs,total_time,residual2D(A0,B,B0,X,nrhs));
+        free2D(B,X,nrhs);
+        free2D(B0,X,nrhs);
+    }
+    if (A0!=NULL)
+        free2D(A0,X,Y);
+    return 0;
+}
@@ -0,0 +1,256 @@
+/**************************************************
+# Copyright (C) 2014 Raptis Dimos <raptis.dimos@yahoo.gr>
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+# **************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpi.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include <sys/time.h>
+#include "utils.h"
+#include "mpi_utils.h"
+
+//Owner, local line and global line of the chosen distribution
+#define OWNER(k) (dist==DIST_BLOCK ? (k)/x : (k)%size)
+#define LOCAL(k) (dist==DIST_BLOCK ? (k)%x : (k)/size)
+#define GLOBAL(i) (dist==DIST_BLOCK ? rank*x+(i) : (i)*size+rank)
+
+
+//Tell the other processes that the lines of this process before line ready
+//are finished. The lines of a process are finished in increasing order, so one
+//counter per process tells which of them can be read
+static void publish(int ready, int rank, MPI_Win win, MPI_Win flags) {
+    MPI_Win_sync(win);
+    MPI_Accumulate(&ready,1,MPI_INT,rank,0,1,MPI_INT,MPI_REPLACE,flags);
+    MPI_Win_flush(rank,flags);
+}
+
+int main (int argc, char * argv[]) {
+    int rank,size;
+#ifdef _OPENMP
+    //Hybrid build: only the master thread talks to MPI
+    int provided;
+    MPI_Init_thread(&argc,&argv,MPI_THREAD_FUNNELED,&provided);
+    if (provided<MPI_THREAD_FUNNELED) {
+        fprintf(stderr,"The MPI library does not support MPI_THREAD_FUNNELED!\n");
+        MPI_Abort(MPI_COMM_WORLD,-1);
+    }
+#else
+    MPI_Init(&argc,&argv);
+#endif
+    MPI_Comm_size(MPI_COMM_WORLD,&size);
+    MPI_Comm_rank(MPI_COMM_WORLD,&rank);
+
+    int X,Y,x,y,i,k,g,owner,dist,ready,flag=0;
+    int * known;
+    double * pivot;
+    double ** localA,*temp_line;
+    MPI_Win win,flags;
+    X=input_size(argv[1]);
+    Y=X;
+    //Number of right-hand sides to solve for after the factorization
+    int nrhs=env_int("NRHS",0);
+    int verify=env_int("VERIFY",0);
+    double ** localA0=NULL;
+    //Warmup and timed runs of the benchmark mode
+    bench_t bench;
+    int run,runs,threads=1;
+    //Line distribution: block (default) or cyclic
+    dist=DIST_BLOCK;
+    if (argc>2 && strcmp(argv[2],"cyclic")==0)
+        dist=DIST_CYCLIC;
+    char * filename=(dist==DIST_BLOCK ? "output_rma_block" : "output_rma_cyclic");
+    char * variant=(dist==DIST_BLOCK ? "LU-RMA-Block" : "LU-RMA-Cyclic");
+
+    temp_line =(double *)malloc(Y*sizeof(double));
+    known =(int *)malloc(size*sizeof(int));
+
+    //Local dimensions x,y
+    x=(X+size-1)/size;
+    y=Y;
+
+    //Allocate local matrix, every rank reads its own rows of a matrix
+    //file or makes its own rows of a random array
+    localA=malloc2D(x,y);
+    input_rows(argv[1],localA,x,X,Y,dist,filename,MPI_COMM_WORLD);
+    //Keep the original rows to check the factors and the solve stage and to
+    //restart benchmark runs
+    bench_init(&bench);
+    runs=bench_runs(&bench);
+    if (nrhs>0 || runs>1 || verify) {
+        localA0=malloc2D(x,y);
+        copy2D(localA0,localA,x,y);
+    }
+
+    //Expose the local lines and the ready counter of every process. The lines
+    //are contiguous with leading dimension Y, so line i of any process is at
+    //displacement i*Y. A single passive-target epoch covers the whole run
+    MPI_Win_create(localA[0],(MPI_Aint)x*Y*sizeof(double),sizeof(double),MPI_INFO_NULL,MPI_COMM_WORLD,&win);
+    MPI_Win_create(&flag,sizeof(int),sizeof(int),MPI_INFO_NULL,MPI_COMM_WORLD,&flags);
+    MPI_Win_lock_all(MPI_MODE_NOCHECK,win);
+    MPI_Win_lock_all(MPI_MODE_NOCHECK,flags);
+
+    //Timers
+    struct timeval ts,tf,time1,time2,time3,time4;
+    double total_time=0,computation_time=0,communication_time=0,threaded_time=0,run_time;
+
+    for (run=0;run<runs;run++) {
+        //Every benchmark run starts again from the original rows
+        if (run>0)
+            copy2D(localA,localA0,x,y);
+        //Line 0 is ready from the start, nothing else is
+        publish(1,rank,win,flags);
+        for (i=0;i<size;i++)
+            known[i]=1;
+        communication_time=0;
+        threaded_time=0;
+        MPI_Barrier(MPI_COMM_WORLD);
+        gettimeofday(&ts,NULL);
+
+        for (k=0;k<X-1;k++){
+            MPI_Pcontrol(TRACE_STEP,k);
+            owner=OWNER(k);
+            if (rank == owner)
+                pivot=localA[LOCAL(k)];
+            else {
+                //Wait until the owner has finished line k and read it, the
+                //owner goes on with its own lines meanwhile
+                gettimeofday(&time1,NULL);
+                while (known[owner] <= k) {
+                    MPI_Fetch_and_op(NULL,&ready,MPI_INT,owner,0,MPI_NO_OP,flags);
+                    MPI_Win_flush(owner,flags);
+                    known[owner]=ready;
+                }
+                MPI_Get(&temp_line[k],X-k,MPI_DOUBLE,owner,(MPI_Aint)LOCAL(k)*Y+k,X-k,MPI_DOUBLE,win);
+                MPI_Win_flush(owner,win);
+                gettimeofday(&time2,NULL);
+                communication_time+=time2.tv_sec-time1.tv_sec+(time2.tv_usec-time1.tv_usec)*0.000001;
+                pivot=temp_line;
+            }
+
+            gettimeofday(&time3,NULL);
+            //The next pivot line is updated and published first, so that its
+            //readers do not wait for the rest of the step
+            if (OWNER(k+1) == rank) {
+                eliminate_row(localA[LOCAL(k+1)],pivot,k,X);
+                publish(k+2,rank,win,flags);
+            }
+#ifdef _OPENMP
+            #pragma omp parallel for private(g) schedule(static)
+#endif
+            for(i=0;i<x;i++){
+                g=GLOBAL(i);
+                if (g > k+1 && g < X)
+                    eliminate_row(localA[i],pivot,k,X);
+            }
+            gettimeofday(&time4,NULL);
+            threaded_time+=time4.tv_sec-time3.tv_sec+(time4.tv_usec-time3.tv_usec)*0.000001;
+        }
+
+        MPI_Pcontrol(TRACE_STEP,-1);
+        gettimeofday(&tf,NULL);
+        total_time=tf.tv_sec-ts.tv_sec+(tf.tv_usec-ts.tv_usec)*0.000001;
+        computation_time=total_time-communication_time;
+        MPI_Reduce(&total_time,&run_time,1,MPI_DOUBLE,MPI_MAX,0,MPI_COMM_WORLD);
+        bench_time(&bench,run,run_time);
+        //No process may restart the lines while others still read them
+        MPI_Barrier(MPI_COMM_WORLD);
+    }
+
+    MPI_Win_unlock_all(flags);
+    MPI_Win_unlock_all(win);
+    MPI_Win_free(&flags);
+    MPI_Win_free(&win);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    double avg_total,avg_comp,avg_comm,max_total,max_comp,max_comm;
+    MPI_Reduce(&total_time,&max_total,1,MPI_DOUBLE,MPI_MAX,0,MPI_COMM_WORLD);
+    MPI_Reduce(&computation_time,&max_comp,1,MPI_DOUBLE,MPI_MAX,0,MPI_COMM_WORLD);
+    MPI_Reduce(&communication_time,&max_comm,1,MPI_DOUBLE,MPI_MAX,0,MPI_COMM_WORLD);
+    MPI_Reduce(&total_time,&avg_total,1,MPI_DOUBLE,MPI_SUM,0,MPI_COMM_WORLD);
+    MPI_Reduce(&computation_time,&avg_comp,1,MPI_DOUBLE,MPI_SUM,0,MPI_COMM_WORLD);
+    MPI_Reduce(&communication_time,&avg_comm,1,MPI_DOUBLE,MPI_SUM,0,MPI_COMM_WORLD);
+#ifdef _OPENMP
+    double avg_thr,max_thr;
+    MPI_Reduce(&threaded_time,&max_thr,1,MPI_DOUBLE,MPI_MAX,0,MPI_COMM_WORLD);
+    MPI_Reduce(&threaded_time,&avg_thr,1,MPI_DOUBLE,MPI_SUM,0,MPI_COMM_WORLD);
+    avg_thr/=size;
+#endif
+
+    avg_total/=size;
+    avg_comp/=size;
+    avg_comm/=size;
+
+    if (rank==0) {
+        printf("%s\tSize\t%d\tProcesses\t%d\n",variant,X,size);
+        printf("Max time:\tTotal\t%lf\tComputation\t%lf\tCommunication\t%lf\n",max_total,max_comp,max_comm);
+        printf("Avg time:\tTotal\t%lf\tComputation\t%lf\tCommunication\t%lf\n",avg_total,avg_comp,avg_comm);
+#ifdef _OPENMP
+        printf("Threads per process\t%d\tThreaded computation:\tMax\t%lf\tAvg\t%lf\n",omp_get_max_threads(),max_thr,avg_thr);
+#endif
+        printf("Per-step communication:\tMax\t%lf\tAvg\t%lf\n",max_comm/(X-1),avg_comm/(X-1));
+    }
+
+#ifdef _OPENMP
+    threads=omp_get_max_threads();
+#endif
+    if (rank==0)
+        bench_report(&bench,variant,X,size,threads);
+
+    //Write triangular matrix U and the multipliers
+    output_rows(localA,x,X,Y,dist,filename,MPI_COMM_WORLD);
+
+    //Check the factors against the original rows
+    if (verify) {
+        MPI_Barrier(MPI_COMM_WORLD);
+        gettimeofday(&ts,NULL);
+        double residual=verify_dist(localA0,localA,x,X,dist,MPI_COMM_WORLD);
+        gettimeofday(&tf,NULL);
+        total_time=tf.tv_sec-ts.tv_sec+(tf.tv_usec-ts.tv_usec)*0.000001;
+        if (rank==0)
+            verify_report(variant,residual,total_time);
+    }
+
+
+    //Solve for a batch of NRHS right-hand sides with the distributed factors
+    if (nrhs>0) {
+        double ** localB=malloc2D(x,nrhs), ** localB0=malloc2D(x,nrhs);
+        random_rows(localB,x,X,nrhs,dist,RAND_RHS,MPI_COMM_WORLD);
+        for (i=0;i<x;i++)
+            for (k=0;k<nrhs;k++)
+                localB0[i][k]=localB[i][k];
+        MPI_Barrier(MPI_COMM_WORLD);
+        gettimeofday(&ts,NULL);
+        communication_time=solve_dist(localA,x,X,localB,nrhs,dist,MPI_COMM_WORLD);
+        gettimeofday(&tf,NULL);
+        total_time=tf.tv_sec-ts.tv_sec+(tf.tv_usec-ts.tv_usec)*0.000001;
+        double residual=residual_dist(localA0,localB,localB0,x,X,nrhs,dist,MPI_COMM_WORLD);
+        MPI_Reduce(&total_time,&max_total,1,MPI_DOUBLE,MPI_MAX,0,MPI_COMM_WORLD);
+        MPI_Reduce(&communication_time,&max_comm,1,MPI_DOUBLE,MPI_MAX,0,MPI_COMM_WORLD);
+        if (rank==0)
+            printf("%s-Solve\tRHS\t%d\tMax time:\tTotal\t%lf\tCommunication\t%lf\tResidual\t%e\n",variant,nrhs,max_total,max_comm,residual);
+        free2D(localB,x,nrhs);
+        free2D(localB0,x,nrhs);
+    }
+    if (localA0!=NULL)
+        free2D(localA0,x,y);
+    free(known);
+
+    MPI_Finalize();
+
+    return 0;
+}
@@ -20,26 +20,70 @@
 
 int main(int argc, char * argv[])
 {
-	int X=atoi(argv[1]);
+	int X=input_size(argv[1]);
     int Y=X;
     double ** A=malloc2D(X,Y);
-    init2D(A,X,Y);
+    input2D(A,X,Y,argv[1]);
     int i,j,k;
-    double l;
     struct timeval ts,tf;
-    double total_time;
+    double total_time=0;
 
-	gettimeofday(&ts,NULL);
-	for (k=0;k<X-1;k++)
-		for (i=k+1;i<X;i++) {
-			l=A[i][k]/A[k][k];
-			for (j=k;j<Y;j++)		
-				A[i][j]-=l*A[k][j];
-		}
-	gettimeofday(&tf,NULL);
-	total_time=(tf.tv_sec-ts.tv_sec)+(tf.tv_usec-ts.tv_usec)*0.000001;
+    //Keep a copy of A to check the factors and the solve stage and to restart
+    //benchmark runs
+    int nrhs=env_int("NRHS",0);
+    int verify=env_int("VERIFY",0);
+    bench_t bench;
+    bench_init(&bench);
+    int run,runs=bench_runs(&bench);
+    double ** A0=NULL, ** B, ** B0;
+    if (nrhs>0 || runs>1 || verify) {
+        A0=malloc2D(X,Y);
+        copy2D(A0,A,X,Y);
+    }
+
+    for (run=0;run<runs;run++) {
+        //Every benchmark run starts again from the original array
+        if (run>0)
+            copy2D(A,A0,X,Y);
+        gettimeofday(&ts,NULL);
+        for (k=0;k<X-1;k++)
+            for (i=k+1;i<X;i++)
+                eliminate_row(A[i],A[k],k,Y);
+        gettimeofday(&tf,NULL);
+        total_time=(tf.tv_sec-ts.tv_sec)+(tf.tv_usec-ts.tv_usec)*0.000001;
+        bench_time(&bench,run,total_time);
+    }
 	printf("LU-Serial\t%d\t%.3lf\n",X,total_time);
+    bench_report(&bench,"LU-Serial",X,1,1);
     char * filename="output_serial";
-    print2DFile(A,X,Y,filename);
-	return 0;
+    output2D(A,X,Y,filename);
+
+    //Check the factors against the original array
+    if (verify) {
+        gettimeofday(&ts,NULL);
+        double residual=verify2D(A0,A,X);
+        gettimeofday(&tf,NULL);
+        total_time=(tf.tv_sec-ts.tv_sec)+(tf.tv_usec-ts.tv_usec)*0.000001;
+        verify_report("LU-Serial",residual,total_time);
+    }
+
+    //Solve for a batch of NRHS right-hand sides with the factors
+    if (nrhs>0) {
+        B=malloc2D(X,nrhs);
+        B0=malloc2D(X,nrhs);
+        init2DRHS(B,X,nrhs);
+        for (i=0;i<X;i++)
+            for (j=0;j<nrhs;j++)
+                B0[i][j]=B[i][j];
+        gettimeofday(&ts,NULL);
+        solve2D(A,X,B,0,nrhs);
+        gettimeofday(&tf,NULL);
+        total_time=(tf.tv_sec-ts.tv_sec)+(tf.tv_usec-ts.tv_usec)*0.000001;
+        printf("LU-Serial-Solve\t%d\t%d\t%.3lf\tResidual\t%e\n",X,nrhs,total_time,residual2D(A0,B,B0,X,nrhs));
+        free2D(B,X,nrhs);
+        free2D(B0,X,nrhs);
+    }
+    if (A0!=NULL)
+        free2D(A0,X,Y);
+    return 0;
 }
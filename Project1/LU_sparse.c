@@ -0,0 +1,123 @@
+/**************************************************
+# Copyright (C) 2014 Raptis Dimos <raptis.dimos@yahoo.gr>
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+# **************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <omp.h>
+#include "utils.h"
+#include "sparse.h"
+
+//Sparse LU of a Matrix Market file or of a random N-point 5-point stencil
+//matrix: nested dissection ordering, symbolic analysis and a supernodal
+//multifrontal factorization with openMP tasks. The first line of the report
+//matches the dense programs, the time is ordering+symbolic+numeric.
+
+
+int main(int argc, char * argv[])
+{
+    if (argc<2) {
+        fprintf(stderr,"Usage: %s N|file.mtx [nd|natural]\n",argv[0]);
+        exit(-1);
+    }
+    int ordering=ORDER_ND;
+    if (argc>2) {
+        if (strcmp(argv[2],"natural")==0)
+            ordering=ORDER_NATURAL;
+        else if (strcmp(argv[2],"nd")!=0) {
+            fprintf(stderr,"Usage: %s N|file.mtx [nd|natural]\n",argv[0]);
+            exit(-1);
+        }
+    }
+    csr_t A;
+    if (input_is_file(argv[1]))
+        read_mtx(argv[1],&A);
+    else {
+        if (atoi(argv[1])<1) {
+            fprintf(stderr,"Usage: %s N|file.mtx [nd|natural]\n",argv[0]);
+            exit(-1);
+        }
+        csr_grid(&A,atoi(argv[1]));
+    }
+    int N=A.n;
+    int threads=omp_get_max_threads();
+    int * perm=malloc(N*sizeof(int));
+    if (perm==NULL) {
+        fprintf(stderr,"Malloc failed!\n");
+        exit(-1);
+    }
+    sym_t S;
+    num_t F;
+    struct timeval ts,tf;
+    double order_time,symbolic_time,numeric_time=0,total_time;
+
+    gettimeofday(&ts,NULL);
+    order_sparse(&A,ordering,perm);
+    gettimeofday(&tf,NULL);
+    order_time=(tf.tv_sec-ts.tv_sec)+(tf.tv_usec-ts.tv_usec)*0.000001;
+
+    gettimeofday(&ts,NULL);
+    symbolic(&A,perm,&S);
+    gettimeofday(&tf,NULL);
+    symbolic_time=(tf.tv_sec-ts.tv_sec)+(tf.tv_usec-ts.tv_usec)*0.000001;
+
+    //Benchmark runs repeat the numeric factorization only, the structure
+    //does not change
+    bench_t bench;
+    bench_init(&bench);
+    int run,runs=bench_runs(&bench);
+    for (run=0;run<runs;run++) {
+        if (run>0)
+            num_free(&S,&F);
+        gettimeofday(&ts,NULL);
+        numeric(&A,&S,&F);
+        gettimeofday(&tf,NULL);
+        numeric_time=(tf.tv_sec-ts.tv_sec)+(tf.tv_usec-ts.tv_usec)*0.000001;
+        bench_time(&bench,run,numeric_time);
+    }
+    total_time=order_time+symbolic_time+numeric_time;
+
+    printf("LU-Sparse\t%d\t%.3lf\n",N,total_time);
+    printf("Ordering\t%s\t%.3lf\tSymbolic\t%.3lf\tNumeric\t%.3lf\n",
+            ordering==ORDER_ND ? "nd" : "natural",order_time,symbolic_time,numeric_time);
+    printf("Nonzeros\tA\t%d\tL+U\t%ld\tDense\t%.0lf\n",A.nnz,S.nnz,(double)N*N);
+    printf("Supernodes\t%d\tLargest front\t%d\tThreads\t%d\tGFLOP/s\t%.2lf\n",
+            S.nsuper,S.maxfront,threads,S.flops/numeric_time*1e-9);
+    bench_report_flops(&bench,"LU-Sparse",N,1,threads,S.flops);
+
+    //Solve for a batch of NRHS right-hand sides with the factors, the
+    //solution is the output
+    int nrhs=env_int("NRHS",0);
+    if (nrhs>0) {
+        double ** B=malloc2D(N,nrhs), ** B0=malloc2D(N,nrhs);
+        init2DRHS(B,N,nrhs);
+        copy2D(B0,B,N,nrhs);
+        gettimeofday(&ts,NULL);
+        solve_sparse(&S,&F,B,nrhs);
+        gettimeofday(&tf,NULL);
+        total_time=(tf.tv_sec-ts.tv_sec)+(tf.tv_usec-ts.tv_usec)*0.000001;
+        printf("LU-Sparse-Solve\t%d\t%d\t%.3lf\tResidual\t%e\n",N,nrhs,total_time,residual_sparse(&A,B,B0,nrhs));
+        char * filename="output_sparse";
+        output2D(B,N,nrhs,filename);
+        free2D(B,N,nrhs);
+        free2D(B0,N,nrhs);
+    }
+
+    num_free(&S,&F);
+    sym_free(&S);
+    csr_free(&A);
+    free(perm);
+	return 0;
+}
@@ -0,0 +1,307 @@
+/**************************************************
+# Copyright (C) 2014 Raptis Dimos <raptis.dimos@yahoo.gr>
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+# **************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "utils.h"
+
+//Autotuner for the dense LU programs. "lu_tune tune N [P]" runs every
+//variant and tunable that fits P processes (the openMP programs for P=1)
+//on two scaled-down sizes, fits t(n)=a*n^3+b*n to the two times and
+//keeps the configuration with the lowest predicted time at N. The winner
+//is stored in the cache file per machine, range of N (powers of two), P
+//and OMP_NUM_THREADS. "lu_tune run N [P]" runs the cached configuration
+//at N, tuning first on a miss, and "lu_tune show" prints the cache.
+//
+//TUNE_CACHE    cache file, default lu_tune.cache
+//TUNE_N        larger trial size, default 2048 (never above N)
+//TUNE_REPS     timed runs per trial after one warmup run, default 2
+//TUNE_MPIRUN   launcher of the MPI programs, default "mpirun -np". The
+//              trials pass REPS, WARMUP and BENCH_OUT in the environment, add
+//              -x REPS -x WARMUP -x BENCH_OUT when rank 0 runs on another node
+//TUNE_MACHINE  machine name of the cache entries, default the host name
+
+#define TUNE_CACHE "lu_tune.cache"
+#define TRIAL_N 2048
+#define MAX_CONFIGS 64
+#define LINE 512
+
+typedef struct {
+    char prog[64];
+    char args[64];
+    int mpi;
+} config_t;
+
+static void add(config_t * c, int * n, char * prog, char * args, int mpi) {
+    if (*n==MAX_CONFIGS)
+        return;
+    snprintf(c[*n].prog,sizeof(c[*n].prog),"%s",prog);
+    snprintf(c[*n].args,sizeof(c[*n].args),"%s",args);
+    c[*n].mpi=mpi;
+    (*n)++;
+}
+
+//The production run solves (NRHS) or checks the factors (VERIFY), which
+//LU_2d_block_cyclic does not do
+static int solve_needed(void) {
+    return env_int("NRHS",0)>0 || env_int("VERIFY",0)!=0;
+}
+
+static int solves(config_t * c) {
+    return strcmp(c->prog,"lu_2d_block_cyclic")!=0;
+}
+
+//Candidate configurations for P processes with the given threads each:
+//the hybrid builds replace the MPI ones when there is more than one thread
+static int configs(config_t * c, int P, int threads) {
+    int n=0,pr,i;
+    char grid[64];
+    char * suffix=threads>1 ? "_hybrid" : "";
+    char name[64];
+    char * block_bcast[]={"","1","2","0 16","0 64"};
+    char * cyclic_bcast[]={"","1","2"};
+    char * p2p[]={"","ring 256","ring 1024","ring 4096","tree 1024"};
+    if (P==1) {
+        add(c,&n,"lu_omp","",0);
+        add(c,&n,"lu_omp_blocked","32",0);
+        add(c,&n,"lu_omp_blocked","64",0);
+        add(c,&n,"lu_omp_blocked","128",0);
+        add(c,&n,"lu_omp_tasks","64",0);
+        add(c,&n,"lu_omp_tasks","128",0);
+        add(c,&n,"lu_omp_recursive","",0);
+        return n;
+    }
+    snprintf(name,sizeof(name),"lu_block_bcast%s",suffix);
+    for (i=0;i<5;i++)
+        add(c,&n,name,block_bcast[i],1);
+    snprintf(name,sizeof(name),"lu_cyclic_bcast%s",suffix);
+    for (i=0;i<3;i++)
+        add(c,&n,name,cyclic_bcast[i],1);
+    snprintf(name,sizeof(name),"lu_block_p2p%s",suffix);
+    for (i=0;i<5;i++)
+        add(c,&n,name,p2p[i],1);
+    snprintf(name,sizeof(name),"lu_cyclic_p2p%s",suffix);
+    for (i=0;i<5;i++)
+        add(c,&n,name,p2p[i],1);
+    snprintf(name,sizeof(name),"lu_rma%s",suffix);
+    add(c,&n,name,"block",1);
+    add(c,&n,name,"cyclic",1);
+    //The 2D program has no hybrid build and no solve, the grid is as square
+    //as P allows
+    if (threads==1 && !solve_needed()) {
+        for (pr=1;(pr+1)*(pr+1)<=P;pr++);
+        while (P%pr!=0)
+            pr--;
+        snprintf(grid,sizeof(grid),"%d %d 32",pr,P/pr);
+        add(c,&n,"lu_2d_block_cyclic",grid,1);
+        snprintf(grid,sizeof(grid),"%d %d 64",pr,P/pr);
+        add(c,&n,"lu_2d_block_cyclic",grid,1);
+    }
+    return n;
+}
+
+//Command line of a configuration at size N, the programs are taken from
+//the directory of lu_tune
+static void command(char * cmd, int len, config_t * c, char * dir, int N, int P) {
+    char * mpirun=getenv("TUNE_MPIRUN");
+    if (mpirun==NULL)
+        mpirun="mpirun -np";
+    if (c->mpi)
+        snprintf(cmd,len,"%s %d %s/%s %d %s",mpirun,P,dir,c->prog,N,c->args);
+    else
+        snprintf(cmd,len,"%s/%s %d %s",dir,c->prog,N,c->args);
+}
+
+//Fastest timed run of a configuration at size n from the record the
+//benchmark mode appends to BENCH_OUT, -1 if the run failed
+static double trial(config_t * c, char * dir, int n, int P) {
+    char cmd[3*LINE],run[2*LINE],line[LINE],out[64];
+    double t=-1;
+    FILE * f;
+    snprintf(out,sizeof(out),"lu_tune.%d.csv",(int)getpid());
+    remove(out);
+    command(run,sizeof(run),c,dir,n,P);
+    //Benchmark mode without output files, solves or checks; the warmup
+    //run keeps process startup and cold caches out of the time
+    snprintf(cmd,sizeof(cmd),"env -u OUTPUT -u NRHS -u VERIFY WARMUP=1 REPS=%d BENCH_OUT=%s %s >/dev/null 2>&1",
+            env_int("TUNE_REPS",2),out,run);
+    if (system(cmd)==0 && (f=fopen(out,"r"))!=NULL) {
+        //Header line, then variant,size,procs,threads,warmup,reps,min,...
+        if (fgets(line,sizeof(line),f)!=NULL && fgets(line,sizeof(line),f)!=NULL)
+            sscanf(line,"%*[^,],%*d,%*d,%*d,%*d,%*d,%lf",&t);
+        fclose(f);
+    }
+    remove(out);
+    return t;
+}
+
+//Range [lo,hi) of the powers of two around N
+static void range(int N, int * lo, int * hi) {
+    *lo=1;
+    while (*lo<=N/2)
+        *lo*=2;
+    *hi=2*(*lo);
+}
+
+static void machine(char * name, int len) {
+    char * value=getenv("TUNE_MACHINE");
+    if (value!=NULL)
+        snprintf(name,len,"%s",value);
+    else if (gethostname(name,len)!=0)
+        snprintf(name,len,"unknown");
+    name[len-1]='\0';
+}
+
+//Cache line: machine, N range, P, threads, predicted time, program and
+//its arguments, separated by tabs
+static int lookup(char * cache, char * host, int N, int P, int threads, config_t * c) {
+    char line[LINE],h[256];
+    int lo,hi,p,t,found=0;
+    double time;
+    FILE * f=fopen(cache,"r");
+    if (f==NULL)
+        return 0;
+    while (fgets(line,sizeof(line),f)!=NULL) {
+        config_t e;
+        e.args[0]='\0';
+        line[strcspn(line,"\n")]='\0';
+        if (sscanf(line,"%255[^\t]\t%d\t%d\t%d\t%d\t%lf\t%63[^\t]\t%63[^\t]",h,&lo,&hi,&p,&t,&time,e.prog,e.args)<7)
+            continue;
+        //Later entries replace earlier ones
+        if (strcmp(h,host)==0 && N>=lo && N<hi && p==P && t==threads && (solves(&e) || !solve_needed())) {
+            e.mpi=P>1;
+            *c=e;
+            found=1;
+        }
+    }
+    fclose(f);
+    return found;
+}
+
+static void store(char * cache, char * host, int N, int P, int threads, double time, config_t * c) {
+    int lo,hi;
+    FILE * f=fopen(cache,"a");
+    if (f==NULL) {
+        fprintf(stderr,"Cannot open %s!\n",cache);
+        exit(-1);
+    }
+    range(N,&lo,&hi);
+    fprintf(f,"%s\t%d\t%d\t%d\t%d\t%lf\t%s\t%s\n",host,lo,hi,P,threads,time,c->prog,c->args);
+    fclose(f);
+}
+
+//Tries every configuration at n/2 and n, returns the best one for N
+static config_t tune(char * cache, char * host, char * dir, int N, int P, int threads) {
+    config_t c[MAX_CONFIGS];
+    int i,best=-1,count=configs(c,P,threads),n2=env_int("TUNE_N",TRIAL_N),n1;
+    double t1,t2,a,b,s,pred,best_pred=0;
+    if (n2>N)
+        n2=N;
+    if (n2<2*P)
+        n2=2*P;
+    n1=n2/2;
+    printf("LU-Tune\tMachine\t%s\tN\t%d\tProcesses\t%d\tThreads\t%d\tTrials\t%d %d\n",host,N,P,threads,n1,n2);
+    for (i=0;i<count;i++) {
+        t1=trial(&c[i],dir,n1,P);
+        t2=trial(&c[i],dir,n2,P);
+        if (t1<=0 || t2<=0) {
+            printf("%s %s\tFailed\n",c[i].prog,c[i].args);
+            continue;
+        }
+        //a*n^3 is the factorization, b*n the latency of the n pivot steps.
+        //A fit that is not positive falls back to cubic scaling of t2, and
+        //the prediction is kept between quadratic and cubic scaling of t2
+        //so that noise in t1 cannot make a configuration look free.
+        s=(double)N/n2;
+        a=(t2/n2-t1/n1)/((double)n2*n2-(double)n1*n1);
+        b=t1/n1-a*n1*(double)n1;
+        pred=t2*s*s*s;
+        if (a>0 && b>=0)
+            pred=a*N*N*(double)N+b*N;
+        if (pred<t2*s*s)
+            pred=t2*s*s;
+        if (pred>t2*s*s*s)
+            pred=t2*s*s*s;
+        printf("%s %s\t%d\t%lf\t%d\t%lf\tPredicted\t%lf\n",c[i].prog,c[i].args,n1,t1,n2,t2,pred);
+        if (best<0 || pred<best_pred) {
+            best_pred=pred;
+            best=i;
+        }
+    }
+    if (best<0) {
+        fprintf(stderr,"LU-Tune: no configuration ran, check TUNE_MPIRUN\n");
+        exit(-1);
+    }
+    store(cache,host,N,P,threads,best_pred,&c[best]);
+    printf("LU-Tune\tBest\t%s %s\tPredicted\t%lf\tCached in\t%s\n",c[best].prog,c[best].args,best_pred,cache);
+    return c[best];
+}
+
+
+int main(int argc, char * argv[])
+{
+    char host[256],dir[LINE],cmd[2*LINE],* slash;
+    char * cache=getenv("TUNE_CACHE");
+    int N=0,P=1,threads=env_int("OMP_NUM_THREADS",1);
+    config_t c;
+    if (argc<2 || (strcmp(argv[1],"show")!=0 && argc<3)) {
+        fprintf(stderr,"Usage: %s tune|run N [P], or %s show\n",argv[0],argv[0]);
+        exit(-1);
+    }
+    if (cache==NULL)
+        cache=TUNE_CACHE;
+    if (strcmp(argv[1],"show")==0) {
+        FILE * f=fopen(cache,"r");
+        if (f==NULL)
+            return 0;
+        while (fgets(cmd,sizeof(cmd),f)!=NULL)
+            fputs(cmd,stdout);
+        fclose(f);
+        return 0;
+    }
+    N=atoi(argv[2]);
+    if (argc>3)
+        P=atoi(argv[3]);
+    if (N<2 || P<1 || threads<1) {
+        fprintf(stderr,"Usage: %s tune|run N [P], or %s show\n",argv[0],argv[0]);
+        exit(-1);
+    }
+    machine(host,sizeof(host));
+    snprintf(dir,sizeof(dir),"%s",argv[0]);
+    slash=strrchr(dir,'/');
+    if (slash!=NULL)
+        *slash='\0';
+    else
+        snprintf(dir,sizeof(dir),".");
+
+    if (strcmp(argv[1],"tune")==0) {
+        tune(cache,host,dir,N,P,threads);
+        return 0;
+    }
+    if (strcmp(argv[1],"run")!=0) {
+        fprintf(stderr,"Usage: %s tune|run N [P], or %s show\n",argv[0],argv[0]);
+        exit(-1);
+    }
+    if (!lookup(cache,host,N,P,threads,&c))
+        c=tune(cache,host,dir,N,P,threads);
+    command(cmd,sizeof(cmd),&c,dir,N,P);
+    printf("LU-Tune\tRun\t%s\n",cmd);
+    fflush(stdout);
+    //The production run keeps the environment (OUTPUT, NRHS, VERIFY, ...)
+    execl("/bin/sh","sh","-c",cmd,(char *)NULL);
+    fprintf(stderr,"LU-Tune: cannot run %s\n",cmd);
+    return -1;
+}
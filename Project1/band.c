@@ -0,0 +1,104 @@
+/**************************************************
+# Copyright (C) 2014 Raptis Dimos <raptis.dimos@yahoo.gr>
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+# **************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "utils.h"
+#include "band.h"
+
+#define MIN(a,b) ((a)<(b)?(a):(b))
+
+//Rows g0..g0+n-1 of a random band with the entries of init2D, the
+//diagonal is raised above the sum of the row so that the factorization
+//without pivoting is stable. Positions outside the matrix stay zero.
+void init2DBand(double ** A, int g0, int n, int N, int kl, int ku) {
+    int i,j,g;
+    for (i=0;i<n;i++) {
+        g=g0+i;
+        for (j=g-kl;j<=g+ku;j++)
+            A[i][j-g+kl]=(j>=0 && j<N) ? rand_entry(RAND_MATRIX,g,j) : 0;
+        A[i][kl]+=10.0*(kl+ku);
+    }
+}
+
+//Eliminate with the pivot row p, d rows above a: the multiplier replaces
+//column kl-d of a and the ku columns right of it are updated
+void eliminate_band(double * a, const double * p, int d, int kl, int ku) {
+    double l=a[kl-d]/p[kl];
+    a[kl-d]=l;
+    axpy_row(&a[kl-d+1],&p[kl+1],l,ku);
+}
+
+//Factor rows [0,n): every row is eliminated with the (already factored)
+//kl rows above it in order, rows at or past N are skipped
+void lu_band_rows(double ** A, int g0, int n, int N, int kl, int ku) {
+    int i,d;
+    for (i=0;i<n && g0+i<N;i++)
+        for (d=MIN(kl,g0+i);d>0;d--)
+            eliminate_band(A[i],A[i-d],d,kl,ku);
+}
+
+//L*Z=B for rows [0,n), Z overwrites B
+void forward_band(double ** LU, double ** B, int g0, int n, int N, int kl, int nrhs) {
+    int i,j,d;
+    double l;
+    for (i=0;i<n && g0+i<N;i++)
+        for (d=MIN(kl,g0+i);d>0;d--) {
+            l=LU[i][kl-d];
+            for (j=0;j<nrhs;j++)
+                B[i][j]-=l*B[i-d][j];
+        }
+}
+
+//U*X=Z for rows [0,n) from the last one up, X overwrites B
+void backward_band(double ** LU, double ** B, int g0, int n, int N, int kl, int ku, int nrhs) {
+    int i,j,d;
+    double l;
+    for (i=n-1;i>=0;i--) {
+        if (g0+i>=N)
+            continue;
+        for (d=1;d<=MIN(ku,N-1-g0-i);d++) {
+            l=LU[i][kl+d];
+            for (j=0;j<nrhs;j++)
+                B[i][j]-=l*B[i+d][j];
+        }
+        l=1.0/LU[i][kl];
+        for (j=0;j<nrhs;j++)
+            B[i][j]*=l;
+    }
+}
+
+//Largest |A*X-B|, |A| and |X| of rows [0,n) in max[0], max[1] and max[2],
+//the scaled residual of residual2D is max[0]/(max[1]*max[2]*N)
+void residual_band(double ** A, double ** X, double ** B, int g0, int n, int N, int kl, int ku, int nrhs, double * max) {
+    int i,j,d,g;
+    double r;
+    max[0]=max[1]=max[2]=0;
+    for (i=0;i<n && g0+i<N;i++) {
+        g=g0+i;
+        for (j=0;j<nrhs;j++) {
+            r=-B[i][j];
+            for (d=-MIN(kl,g);d<=MIN(ku,N-1-g);d++)
+                r+=A[i][kl+d]*X[i+d][j];
+            if (fabs(r)>max[0])
+                max[0]=fabs(r);
+            if (fabs(X[i][j])>max[2])
+                max[2]=fabs(X[i][j]);
+        }
+        for (d=0;d<BAND_WIDTH(kl,ku);d++)
+            if (fabs(A[i][d])>max[1])
+                max[1]=fabs(A[i][d]);
+    }
+}
@@ -0,0 +1,36 @@
+/**************************************************
+# Copyright (C) 2014 Raptis Dimos <raptis.dimos@yahoo.gr>
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+# **************************************************/
+
+#ifndef BAND_H__
+#define BAND_H__
+
+//Band storage of an N x N matrix with kl diagonals below and ku above the
+//main one: row i holds columns i-kl..i+ku, element (i,j) is A[i][j-i+kl]
+//and the diagonal is column kl. Without pivoting the factors stay in the
+//band, L below the diagonal and U on and above it.
+//
+//The functions below take the rows of one process: A[i] is global row
+//g0+i and the kl rows before A[0] (and the ku rows after the last one for
+//the back substitution) may be halo rows of the neighbours.
+
+#define BAND_WIDTH(kl,ku) ((kl)+(ku)+1)
+
+void init2DBand(double ** A, int g0, int n, int N, int kl, int ku);
+void eliminate_band(double * a, const double * p, int d, int kl, int ku);
+void lu_band_rows(double ** A, int g0, int n, int N, int kl, int ku);
+void forward_band(double ** LU, double ** B, int g0, int n, int N, int kl, int nrhs);
+void backward_band(double ** LU, double ** B, int g0, int n, int N, int kl, int ku, int nrhs);
+void residual_band(double ** A, double ** X, double ** B, int g0, int n, int N, int kl, int ku, int nrhs, double * max);
+
+#endif  /* BAND_H__ */
@@ -0,0 +1,151 @@
+/**************************************************
+# Copyright (C) 2014 Raptis Dimos <raptis.dimos@yahoo.gr>
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+# **************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "utils.h"
+#include "batch.h"
+
+#define MIN(a,b) ((a)<(b)?(a):(b))
+
+//Copy count matrices into the interleaved layout, the last group is
+//padded with identity matrices
+void batch_interleave(double * dst, const double * src, int n, int count) {
+    int g,v,e,m,nn=n*n,groups=BATCH_GROUPS(count);
+    double * d;
+    for (g=0;g<groups;g++) {
+        d=&dst[(size_t)g*nn*BATCH_LANES];
+        for (v=0;v<BATCH_LANES;v++) {
+            m=g*BATCH_LANES+v;
+            if (m<count)
+                for (e=0;e<nn;e++)
+                    d[e*BATCH_LANES+v]=src[(size_t)m*nn+e];
+            else
+                for (e=0;e<nn;e++)
+                    d[e*BATCH_LANES+v]=(e%(n+1)==0);
+        }
+    }
+}
+
+void batch_deinterleave(double * dst, const double * src, int n, int count) {
+    int g,v,e,m,nn=n*n,groups=BATCH_GROUPS(count);
+    const double * s;
+    for (g=0;g<groups;g++) {
+        s=&src[(size_t)g*nn*BATCH_LANES];
+        for (v=0;v<BATCH_LANES;v++) {
+            m=g*BATCH_LANES+v;
+            if (m<count)
+                for (e=0;e<nn;e++)
+                    dst[(size_t)m*nn+e]=s[e*BATCH_LANES+v];
+        }
+    }
+}
+
+//Factor the BATCH_LANES matrices of an interleaved group together, the
+//lane loops are the vector dimension. Inlined with a constant n, the
+//compiler unrolls and vectorizes it for that size.
+static inline __attribute__((always_inline)) void lu_group(double * a, int n) {
+    int i,j,k,v;
+    double l[BATCH_LANES];
+    double * restrict ai;
+    const double * restrict ak;
+    for (k=0;k<n-1;k++) {
+        ak=&a[k*n*BATCH_LANES];
+        for (i=k+1;i<n;i++) {
+            ai=&a[i*n*BATCH_LANES];
+            for (v=0;v<BATCH_LANES;v++) {
+                l[v]=ai[k*BATCH_LANES+v]/ak[k*BATCH_LANES+v];
+                ai[k*BATCH_LANES+v]=l[v];
+            }
+            for (j=k+1;j<n;j++)
+                for (v=0;v<BATCH_LANES;v++)
+                    ai[j*BATCH_LANES+v]-=l[v]*ak[j*BATCH_LANES+v];
+        }
+    }
+}
+
+//One kernel per instruction set, with specialized copies for common sizes.
+//The generic one already uses SSE2 on x86-64.
+#define GROUP_KERNEL(name) \
+static void name(double * a, int n) { \
+    switch (n) { \
+    case 4: lu_group(a,4); break; \
+    case 8: lu_group(a,8); break; \
+    case 16: lu_group(a,16); break; \
+    case 32: lu_group(a,32); break; \
+    default: lu_group(a,n); \
+    } \
+}
+
+GROUP_KERNEL(group_generic)
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2,fma"))) GROUP_KERNEL(group_avx2)
+__attribute__((target("avx512f"))) GROUP_KERNEL(group_avx512)
+#endif
+
+//Kernel for the instruction set the row kernels use (SIMD=...)
+static void (*group_kernel(void))(double *, int) {
+#if defined(__x86_64__) || defined(__i386__)
+    if (simd_level()>=SIMD_AVX512)
+        return group_avx512;
+    if (simd_level()>=SIMD_AVX2)
+        return group_avx2;
+#endif
+    return group_generic;
+}
+
+void lu_batch_interleaved(double * A, int n, int count) {
+    int g,groups=BATCH_GROUPS(count);
+    void (*kernel)(double *, int)=group_kernel();
+    #pragma omp parallel for schedule(static)
+    for (g=0;g<groups;g++)
+        kernel(&A[(size_t)g*n*n*BATCH_LANES],n);
+}
+
+//Small matrices go through the interleaved layout one group at a time, in
+//a buffer of every thread that stays in cache. Larger ones have rows long
+//enough for the row kernels and are factored one by one.
+void lu_batch(double * A, int n, int count) {
+    int g,m,i,k,nn=n*n,groups=BATCH_GROUPS(count);
+    double * a;
+    if (n>BATCH_INTERLEAVE_MAX) {
+        #pragma omp parallel for private(a,i,k) schedule(static)
+        for (m=0;m<count;m++) {
+            a=&A[(size_t)m*nn];
+            for (k=0;k<n-1;k++)
+                for (i=k+1;i<n;i++)
+                    eliminate_row(&a[i*n],&a[k*n],k,n);
+        }
+        return;
+    }
+    void (*kernel)(double *, int)=group_kernel();
+    #pragma omp parallel private(a,m)
+    {
+        double * buf=malloc(nn*BATCH_LANES*sizeof(double));
+        if (buf==NULL) {
+            fprintf(stderr,"Malloc failed!\n");
+            exit(-1);
+        }
+        #pragma omp for schedule(static)
+        for (g=0;g<groups;g++) {
+            a=&A[(size_t)g*nn*BATCH_LANES];
+            m=MIN(BATCH_LANES,count-g*BATCH_LANES);
+            batch_interleave(buf,a,n,m);
+            kernel(buf,n);
+            batch_deinterleave(a,buf,n,m);
+        }
+        free(buf);
+    }
+}
@@ -0,0 +1,38 @@
+/**************************************************
+# Copyright (C) 2014 Raptis Dimos <raptis.dimos@yahoo.gr>
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+# **************************************************/
+
+#ifndef BATCH_H__
+#define BATCH_H__
+
+//Batched LU of many independent n x n matrices, stored one after the other
+//in row-major order: matrix m starts at A+m*n*n. The matrices are shared
+//among the openMP threads, every matrix is factored by a single thread.
+
+//Matrices per group of the interleaved layout, one 512-bit vector of doubles
+#define BATCH_LANES 8
+//Largest size factored in the interleaved layout
+#define BATCH_INTERLEAVE_MAX 32
+
+//Interleaved layout: element (i,j) of matrix m is at
+//A[(m/BATCH_LANES)*n*n*BATCH_LANES+(i*n+j)*BATCH_LANES+m%BATCH_LANES],
+//so the same element of BATCH_LANES matrices fills one vector. Missing
+//matrices of the last group are padded with the identity.
+#define BATCH_GROUPS(count) (((count)+BATCH_LANES-1)/BATCH_LANES)
+
+void batch_interleave(double * dst, const double * src, int n, int count);
+void batch_deinterleave(double * dst, const double * src, int n, int count);
+void lu_batch_interleaved(double * A, int n, int count);
+void lu_batch(double * A, int n, int count);
+
+#endif  /* BATCH_H__ */
@@ -0,0 +1,340 @@
+/**************************************************
+# Copyright (C) 2014 Raptis Dimos <raptis.dimos@yahoo.gr>
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+# **************************************************/
+
+//PMPI tracer for the MPI variants. Every point-to-point, collective and
+//one-sided call the variants make is timed and recorded with its peer (or
+//root, or target) as a rank of MPI_COMM_WORLD, its
+//byte count and the pivot step the program announced last through
+//MPI_Pcontrol(TRACE_STEP,k). At MPI_Finalize rank 0 collects the events of
+//all ranks and writes them as a Chrome trace (TRACE_OUT, default
+//trace.json), one track per rank, that chrome://tracing and Perfetto load.
+//Preload it with LD_PRELOAD=./libmpitrace.so, the programs do not change.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <mpi.h>
+#include "mpi_utils.h"
+
+#define OP_SEND 0
+#define OP_ISEND 1
+#define OP_RECV 2
+#define OP_BCAST 3
+#define OP_IBCAST 4
+#define OP_SCATTER 5
+#define OP_GATHER 6
+#define OP_WAIT 7
+#define OP_WAITALL 8
+#define OP_SCATTERV 9
+#define OP_GATHERV 10
+#define OP_SENDRECV 11
+#define OP_REDUCE 12
+#define OP_ALLREDUCE 13
+#define OP_GET 14
+#define OP_ACCUMULATE 15
+#define OP_FETCH_AND_OP 16
+#define OP_WIN_FLUSH 17
+
+static char * op_names[]={"MPI_Send","MPI_Isend","MPI_Recv","MPI_Bcast","MPI_Ibcast",
+    "MPI_Scatter","MPI_Gather","MPI_Wait","MPI_Waitall","MPI_Scatterv","MPI_Gatherv",
+    "MPI_Sendrecv","MPI_Reduce","MPI_Allreduce","MPI_Get","MPI_Accumulate",
+    "MPI_Fetch_and_op","MPI_Win_flush"};
+
+typedef struct {
+    double t0;
+    double t1;
+    long bytes;
+    int op;
+    int peer;
+    int k;
+} trace_event;
+
+static trace_event * events=NULL;
+static int nevents=0,maxevents=0;
+static int step=-1;
+static double start;
+
+static void record(int op, double t0, int peer, int count, MPI_Datatype type, int k) {
+    int size=0;
+    double t1=PMPI_Wtime();
+    if (nevents==maxevents) {
+        maxevents=maxevents ? 2*maxevents : 4096;
+        events=realloc(events,maxevents*sizeof(trace_event));
+        if (events==NULL) {
+            fprintf(stderr,"Malloc failed!\n");
+            exit(-1);
+        }
+    }
+    if (count>0)
+        PMPI_Type_size(type,&size);
+    events[nevents].t0=t0-start;
+    events[nevents].t1=t1-start;
+    events[nevents].bytes=(long)count*size;
+    events[nevents].op=op;
+    events[nevents].peer=peer;
+    events[nevents].k=k;
+    nevents++;
+}
+
+//Rank r of a group as a rank of MPI_COMM_WORLD, so that the peers of calls
+//on the row and column communicators of the 2D grid and on windows match the
+//tracks of the trace. MPI_ANY_SOURCE and MPI_PROC_NULL are kept
+static int world_rank(MPI_Group group, int r) {
+    MPI_Group world;
+    int w=r;
+    if (r>=0) {
+        PMPI_Comm_group(MPI_COMM_WORLD,&world);
+        PMPI_Group_translate_ranks(group,1,&r,world,&w);
+        PMPI_Group_free(&world);
+    }
+    return w;
+}
+
+static int comm_peer(MPI_Comm comm, int r) {
+    MPI_Group group;
+    int w;
+    if (comm==MPI_COMM_WORLD || r<0)
+        return r;
+    PMPI_Comm_group(comm,&group);
+    w=world_rank(group,r);
+    PMPI_Group_free(&group);
+    return w;
+}
+
+static int win_peer(MPI_Win win, int r) {
+    MPI_Group group;
+    int w;
+    PMPI_Win_get_group(win,&group);
+    w=world_rank(group,r);
+    PMPI_Group_free(&group);
+    return w;
+}
+
+//Common start of the time axis on all ranks
+static void trace_start(void) {
+    PMPI_Barrier(MPI_COMM_WORLD);
+    start=PMPI_Wtime();
+}
+
+int MPI_Init(int * argc, char *** argv) {
+    int ret=PMPI_Init(argc,argv);
+    trace_start();
+    return ret;
+}
+
+int MPI_Init_thread(int * argc, char *** argv, int required, int * provided) {
+    int ret=PMPI_Init_thread(argc,argv,required,provided);
+    trace_start();
+    return ret;
+}
+
+//MPI_Pcontrol(TRACE_STEP,k) sets the pivot step of the following events,
+//a negative k ends the factorization
+int MPI_Pcontrol(const int level, ...) {
+    va_list ap;
+    if (level==TRACE_STEP) {
+        va_start(ap,level);
+        step=va_arg(ap,int);
+        va_end(ap);
+    }
+    return MPI_SUCCESS;
+}
+
+int MPI_Send(const void * buf, int count, MPI_Datatype type, int dest, int tag, MPI_Comm comm) {
+    double t0=PMPI_Wtime();
+    int ret=PMPI_Send(buf,count,type,dest,tag,comm);
+    record(OP_SEND,t0,comm_peer(comm,dest),count,type,step);
+    return ret;
+}
+
+int MPI_Isend(const void * buf, int count, MPI_Datatype type, int dest, int tag, MPI_Comm comm, MPI_Request * req) {
+    double t0=PMPI_Wtime();
+    int ret=PMPI_Isend(buf,count,type,dest,tag,comm,req);
+    record(OP_ISEND,t0,comm_peer(comm,dest),count,type,step);
+    return ret;
+}
+
+int MPI_Recv(void * buf, int count, MPI_Datatype type, int source, int tag, MPI_Comm comm, MPI_Status * status) {
+    double t0=PMPI_Wtime();
+    int ret=PMPI_Recv(buf,count,type,source,tag,comm,status);
+    record(OP_RECV,t0,comm_peer(comm,source),count,type,step);
+    return ret;
+}
+
+int MPI_Bcast(void * buf, int count, MPI_Datatype type, int root, MPI_Comm comm) {
+    double t0=PMPI_Wtime();
+    int ret=PMPI_Bcast(buf,count,type,root,comm);
+    record(OP_BCAST,t0,comm_peer(comm,root),count,type,step);
+    return ret;
+}
+
+int MPI_Ibcast(void * buf, int count, MPI_Datatype type, int root, MPI_Comm comm, MPI_Request * req) {
+    double t0=PMPI_Wtime();
+    int ret=PMPI_Ibcast(buf,count,type,root,comm,req);
+    record(OP_IBCAST,t0,comm_peer(comm,root),count,type,step);
+    return ret;
+}
+
+int MPI_Scatter(const void * sendbuf, int sendcount, MPI_Datatype sendtype, void * recvbuf, int recvcount, MPI_Datatype recvtype, int root, MPI_Comm comm) {
+    double t0=PMPI_Wtime();
+    int ret=PMPI_Scatter(sendbuf,sendcount,sendtype,recvbuf,recvcount,recvtype,root,comm);
+    record(OP_SCATTER,t0,comm_peer(comm,root),recvcount,recvtype,step);
+    return ret;
+}
+
+int MPI_Gather(const void * sendbuf, int sendcount, MPI_Datatype sendtype, void * recvbuf, int recvcount, MPI_Datatype recvtype, int root, MPI_Comm comm) {
+    double t0=PMPI_Wtime();
+    int ret=PMPI_Gather(sendbuf,sendcount,sendtype,recvbuf,recvcount,recvtype,root,comm);
+    record(OP_GATHER,t0,comm_peer(comm,root),sendcount,sendtype,step);
+    return ret;
+}
+
+int MPI_Scatterv(const void * sendbuf, const int * sendcounts, const int * displs, MPI_Datatype sendtype, void * recvbuf, int recvcount, MPI_Datatype recvtype, int root, MPI_Comm comm) {
+    double t0=PMPI_Wtime();
+    int ret=PMPI_Scatterv(sendbuf,sendcounts,displs,sendtype,recvbuf,recvcount,recvtype,root,comm);
+    record(OP_SCATTERV,t0,comm_peer(comm,root),recvcount,recvtype,step);
+    return ret;
+}
+
+int MPI_Gatherv(const void * sendbuf, int sendcount, MPI_Datatype sendtype, void * recvbuf, const int * recvcounts, const int * displs, MPI_Datatype recvtype, int root, MPI_Comm comm) {
+    double t0=PMPI_Wtime();
+    int ret=PMPI_Gatherv(sendbuf,sendcount,sendtype,recvbuf,recvcounts,displs,recvtype,root,comm);
+    record(OP_GATHERV,t0,comm_peer(comm,root),sendcount,sendtype,step);
+    return ret;
+}
+
+int MPI_Sendrecv(const void * sendbuf, int sendcount, MPI_Datatype sendtype, int dest, int sendtag, void * recvbuf, int recvcount, MPI_Datatype recvtype, int source, int recvtag, MPI_Comm comm, MPI_Status * status) {
+    double t0=PMPI_Wtime();
+    int ret=PMPI_Sendrecv(sendbuf,sendcount,sendtype,dest,sendtag,recvbuf,recvcount,recvtype,source,recvtag,comm,status);
+    record(OP_SENDRECV,t0,comm_peer(comm,dest),sendcount,sendtype,step);
+    return ret;
+}
+
+int MPI_Reduce(const void * sendbuf, void * recvbuf, int count, MPI_Datatype type, MPI_Op op, int root, MPI_Comm comm) {
+    double t0=PMPI_Wtime();
+    int ret=PMPI_Reduce(sendbuf,recvbuf,count,type,op,root,comm);
+    record(OP_REDUCE,t0,comm_peer(comm,root),count,type,step);
+    return ret;
+}
+
+int MPI_Allreduce(const void * sendbuf, void * recvbuf, int count, MPI_Datatype type, MPI_Op op, MPI_Comm comm) {
+    double t0=PMPI_Wtime();
+    int ret=PMPI_Allreduce(sendbuf,recvbuf,count,type,op,comm);
+    record(OP_ALLREDUCE,t0,-1,count,type,step);
+    return ret;
+}
+
+//One-sided calls only start the transfer, MPI_Win_flush shows the time spent
+//waiting for it
+int MPI_Get(void * buf, int count, MPI_Datatype type, int target, MPI_Aint disp, int target_count, MPI_Datatype target_type, MPI_Win win) {
+    double t0=PMPI_Wtime();
+    int ret=PMPI_Get(buf,count,type,target,disp,target_count,target_type,win);
+    record(OP_GET,t0,win_peer(win,target),count,type,step);
+    return ret;
+}
+
+int MPI_Accumulate(const void * buf, int count, MPI_Datatype type, int target, MPI_Aint disp, int target_count, MPI_Datatype target_type, MPI_Op op, MPI_Win win) {
+    double t0=PMPI_Wtime();
+    int ret=PMPI_Accumulate(buf,count,type,target,disp,target_count,target_type,op,win);
+    record(OP_ACCUMULATE,t0,win_peer(win,target),count,type,step);
+    return ret;
+}
+
+int MPI_Fetch_and_op(const void * buf, void * result, MPI_Datatype type, int target, MPI_Aint disp, MPI_Op op, MPI_Win win) {
+    double t0=PMPI_Wtime();
+    int ret=PMPI_Fetch_and_op(buf,result,type,target,disp,op,win);
+    record(OP_FETCH_AND_OP,t0,win_peer(win,target),1,type,step);
+    return ret;
+}
+
+int MPI_Win_flush(int target, MPI_Win win) {
+    double t0=PMPI_Wtime();
+    int ret=PMPI_Win_flush(target,win);
+    record(OP_WIN_FLUSH,t0,win_peer(win,target),0,MPI_BYTE,step);
+    return ret;
+}
+
+int MPI_Wait(MPI_Request * req, MPI_Status * status) {
+    double t0=PMPI_Wtime();
+    int ret=PMPI_Wait(req,status);
+    record(OP_WAIT,t0,-1,0,MPI_BYTE,step);
+    return ret;
+}
+
+int MPI_Waitall(int count, MPI_Request reqs[], MPI_Status statuses[]) {
+    double t0=PMPI_Wtime();
+    int ret=PMPI_Waitall(count,reqs,statuses);
+    record(OP_WAITALL,t0,-1,0,MPI_BYTE,step);
+    return ret;
+}
+
+//Write the events of all ranks, rank r is process r of the trace
+static void write_trace(trace_event * all, int * counts, int size) {
+    int r,i,n=0;
+    char * name=getenv("TRACE_OUT");
+    FILE * f;
+    trace_event * e;
+    if (name==NULL)
+        name="trace.json";
+    f=fopen(name,"w");
+    if (f==NULL) {
+        fprintf(stderr,"Cannot open %s!\n",name);
+        return;
+    }
+    fprintf(f,"{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (r=0;r<size;r++) {
+        fprintf(f,"{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"rank %d\"}},\n",r,r);
+        for (i=0;i<counts[r];i++,n++) {
+            e=&all[n];
+            fprintf(f,"{\"name\":\"%s\",\"cat\":\"mpi\",\"ph\":\"X\",\"pid\":%d,\"tid\":0,\"ts\":%.3lf,\"dur\":%.3lf,"
+                    "\"args\":{\"peer\":%d,\"bytes\":%ld,\"k\":%d}},\n",
+                    op_names[e->op],r,e->t0*1e6,(e->t1-e->t0)*1e6,e->peer,e->bytes,e->k);
+        }
+    }
+    //Closing metadata event, so no event needs to drop its comma
+    fprintf(f,"{\"name\":\"trace_info\",\"ph\":\"M\",\"pid\":0,\"args\":{\"ranks\":%d,\"events\":%d}}\n]}\n",size,n);
+    fclose(f);
+}
+
+int MPI_Finalize(void) {
+    int rank,size,r,total=0;
+    int * counts=NULL, * displs=NULL;
+    trace_event * all=NULL;
+    PMPI_Comm_rank(MPI_COMM_WORLD,&rank);
+    PMPI_Comm_size(MPI_COMM_WORLD,&size);
+    if (rank==0) {
+        counts=malloc(size*sizeof(int));
+        displs=malloc(size*sizeof(int));
+    }
+    PMPI_Gather(&nevents,1,MPI_INT,counts,1,MPI_INT,0,MPI_COMM_WORLD);
+    if (rank==0) {
+        for (r=0;r<size;r++) {
+            displs[r]=total*sizeof(trace_event);
+            total+=counts[r];
+            counts[r]*=sizeof(trace_event);
+        }
+        all=malloc((total>0 ? total : 1)*sizeof(trace_event));
+    }
+    PMPI_Gatherv(events,nevents*sizeof(trace_event),MPI_BYTE,all,counts,displs,MPI_BYTE,0,MPI_COMM_WORLD);
+    if (rank==0) {
+        for (r=0;r<size;r++)
+            counts[r]/=sizeof(trace_event);
+        write_trace(all,counts,size);
+        free(all);
+        free(counts);
+        free(displs);
+    }
+    free(events);
+    return PMPI_Finalize();
+}
@@ -0,0 +1,553 @@
+/**************************************************
+# Copyright (C) 2014 Raptis Dimos <raptis.dimos@yahoo.gr>
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+# **************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <mpi.h>
+#include <sys/time.h>
+#include "utils.h"
+#include "mpi_utils.h"
+
+//Row block of the distributed triangular solves
+#define SOLVE_NB 64
+
+#define MIN(a,b) ((a)<(b)?(a):(b))
+#define MAX(a,b) ((a)>(b)?(a):(b))
+
+int relay_mode(char * name) {
+    if (strcmp(name,"ring")==0)
+        return RELAY_RING;
+    if (strcmp(name,"tree")==0)
+        return RELAY_TREE;
+    return RELAY_LOOP;
+}
+
+char * relay_name(int mode) {
+    if (mode==RELAY_RING)
+        return "ring";
+    if (mode==RELAY_TREE)
+        return "tree";
+    return "loop";
+}
+
+//Upper bound of the forwarding requests one row of count elements needs
+int relay_max_requests(int count, int segment) {
+    return 2*(count/segment+1);
+}
+
+//Receive elements [offset,offset+count) of a row from the parent of this
+//process and forward them to its children. Parents and children are taken
+//relative to root, on a ring (rank-1 -> rank -> rank+1) or on a binary tree
+//(children 2r+1 and 2r+2). The sends are non-blocking and their requests
+//are appended to reqs, the caller waits on them before reusing the row.
+void relay_segment(double * row, int offset, int count, int root, int mode, MPI_Comm comm, MPI_Request * reqs, int * nreqs) {
+    int rank,size,rel,parent,child,c,nchildren;
+    MPI_Comm_size(comm,&size);
+    MPI_Comm_rank(comm,&rank);
+    rel=(rank-root+size)%size;
+
+    if (rel!=0) {
+        if (mode==RELAY_TREE)
+            parent=(rel-1)/2;
+        else
+            parent=rel-1;
+        MPI_Recv(&row[offset],count,MPI_DOUBLE,(parent+root)%size,55,comm,MPI_STATUS_IGNORE);
+    }
+
+    nchildren=(mode==RELAY_TREE) ? 2 : 1;
+    for (c=1;c<=nchildren;c++) {
+        if (mode==RELAY_TREE)
+            child=2*rel+c;
+        else
+            child=rel+1;
+        if (child<size) {
+            MPI_Isend(&row[offset],count,MPI_DOUBLE,(child+root)%size,55,comm,&reqs[*nreqs]);
+            (*nreqs)++;
+        }
+    }
+}
+
+//Owner and local index of global row g
+static int row_owner(int g, int x, int size, int dist) {
+    return dist==DIST_CYCLIC ? g%size : g/x;
+}
+
+static int row_local(int g, int x, int size, int dist) {
+    return dist==DIST_CYCLIC ? g/size : g%x;
+}
+
+//Local rows [*i0,*i1) that hold global rows [lo,hi)
+static void row_range(int lo, int hi, int x, int rank, int size, int dist, int * i0, int * i1) {
+    if (dist==DIST_CYCLIC) {
+        *i0=lo>rank ? (lo-rank+size-1)/size : 0;
+        *i1=hi>rank ? (hi-rank+size-1)/size : 0;
+    }
+    else {
+        *i0=lo-rank*x;
+        *i1=hi-rank*x;
+    }
+    *i0=MIN(MAX(*i0,0),x);
+    *i1=MIN(MAX(*i1,0),x);
+}
+
+//Number of local rows that hold real rows of the X-row matrix, any other
+//of the x local rows is left unused
+static int real_rows(int x, int X, int rank, int size, int dist) {
+    int i0,i1;
+    row_range(0,X,x,rank,size,dist,&i0,&i1);
+    return i1-i0;
+}
+
+//Scatter (gather=0) the rows of the X x Y matrix A on rank 0 to the ranks,
+//or gather them back (gather=1). The block distribution is one
+//MPI_Scatterv of a run of rows per rank. In the cyclic one every rank
+//holds q=X/size rows size rows apart, described by one vector type whose
+//extent is a single row so that rank r starts at row r, and the X%size
+//rows left over go one each to the first ranks with a second collective.
+//Either way A has no ghost rows and at most two collectives are issued.
+static void exchange_rows(double ** A, double ** localA, int x, int X, int Y, int dist, int gather, MPI_Comm comm) {
+    int rank,size,r,q,n;
+    int * counts, * displs;
+    double * buf=NULL, * local;
+    MPI_Datatype vec,rounds;
+    MPI_Comm_size(comm,&size);
+    MPI_Comm_rank(comm,&rank);
+    counts=malloc(2*size*sizeof(int));
+    if (counts==NULL) {
+        fprintf(stderr,"Malloc failed!\n");
+        MPI_Abort(comm,-1);
+    }
+    displs=&counts[size];
+    if (rank==0)
+        buf=&A[0][0];
+    local=&localA[0][0];
+    if (dist==DIST_CYCLIC) {
+        q=X/size;
+        MPI_Type_vector(q,Y,size*Y,MPI_DOUBLE,&vec);
+        MPI_Type_create_resized(vec,0,Y*sizeof(double),&rounds);
+        MPI_Type_commit(&rounds);
+        for (r=0;r<size;r++) {
+            counts[r]=q>0;
+            displs[r]=r;
+        }
+        if (gather)
+            MPI_Gatherv(local,q*Y,MPI_DOUBLE,buf,counts,displs,rounds,0,comm);
+        else
+            MPI_Scatterv(buf,counts,displs,rounds,local,q*Y,MPI_DOUBLE,0,comm);
+        MPI_Type_free(&rounds);
+        MPI_Type_free(&vec);
+        if (X%size>0) {
+            for (r=0;r<size;r++) {
+                counts[r]=r<X%size ? Y : 0;
+                displs[r]=(q*size+r)*Y;
+            }
+            local=rank<X%size ? &localA[q][0] : NULL;
+            if (gather)
+                MPI_Gatherv(local,counts[rank],MPI_DOUBLE,buf,counts,displs,MPI_DOUBLE,0,comm);
+            else
+                MPI_Scatterv(buf,counts,displs,MPI_DOUBLE,local,counts[rank],MPI_DOUBLE,0,comm);
+        }
+    }
+    else {
+        for (r=0;r<size;r++) {
+            n=real_rows(x,X,r,size,dist);
+            counts[r]=n*Y;
+            displs[r]=r*x*Y;
+        }
+        if (gather)
+            MPI_Gatherv(local,counts[rank],MPI_DOUBLE,buf,counts,displs,MPI_DOUBLE,0,comm);
+        else
+            MPI_Scatterv(buf,counts,displs,MPI_DOUBLE,local,counts[rank],MPI_DOUBLE,0,comm);
+    }
+    free(counts);
+}
+
+//Scatter the rows of the X x Y matrix A on rank 0
+void scatter_rows(double ** A, double ** localA, int x, int X, int Y, int dist, MPI_Comm comm) {
+    exchange_rows(A,localA,x,X,Y,dist,0,comm);
+}
+
+//Gather the local rows back to the X x Y matrix A on rank 0
+void gather_rows(double ** localA, double ** A, int x, int X, int Y, int dist, MPI_Comm comm) {
+    exchange_rows(A,localA,x,X,Y,dist,1,comm);
+}
+
+//View of a binary matrix file that exposes only the rows of this rank: one
+//contiguous run of rows for the block distribution, every size-th row for
+//the cyclic one. Returns the number of rows in the view.
+static int set_rows_view(MPI_File fh, int x, int X, int Y, int dist, MPI_Comm comm) {
+    int rank,size,n;
+    MPI_Offset disp;
+    MPI_Datatype rows;
+    MPI_Comm_size(comm,&size);
+    MPI_Comm_rank(comm,&rank);
+    n=real_rows(x,X,rank,size,dist);
+    if (dist==DIST_CYCLIC) {
+        disp=sizeof(mat_header)+(MPI_Offset)rank*Y*sizeof(double);
+        MPI_Type_vector(n,Y,size*Y,MPI_DOUBLE,&rows);
+    }
+    else {
+        disp=sizeof(mat_header)+(MPI_Offset)rank*x*Y*sizeof(double);
+        MPI_Type_contiguous(n*Y,MPI_DOUBLE,&rows);
+    }
+    MPI_Type_commit(&rows);
+    MPI_File_set_view(fh,disp,MPI_DOUBLE,rows,"native",MPI_INFO_NULL);
+    MPI_Type_free(&rows);
+    return n;
+}
+
+//Every rank reads its own rows of an X x Y binary matrix file with one
+//collective call, no rank ever holds more than its local rows
+void read_rows(char * filename, double ** localA, int x, int X, int Y, int dist, MPI_Comm comm) {
+    int n;
+    MPI_File fh;
+    if (MPI_File_open(comm,filename,MPI_MODE_RDONLY,MPI_INFO_NULL,&fh)!=MPI_SUCCESS) {
+        fprintf(stderr,"Cannot open %s!\n",filename);
+        MPI_Abort(comm,-1);
+    }
+    n=set_rows_view(fh,x,X,Y,dist,comm);
+    MPI_File_read_all(fh,&localA[0][0],n*Y,MPI_DOUBLE,MPI_STATUS_IGNORE);
+    MPI_File_close(&fh);
+}
+
+//Every rank writes its own rows to an X x Y binary matrix file, rank 0
+//also writes the header
+void write_rows(char * filename, double ** localA, int x, int X, int Y, int dist, MPI_Comm comm) {
+    int rank,n;
+    mat_header h;
+    MPI_File fh;
+    MPI_Comm_rank(comm,&rank);
+    if (MPI_File_open(comm,filename,MPI_MODE_WRONLY|MPI_MODE_CREATE,MPI_INFO_NULL,&fh)!=MPI_SUCCESS) {
+        fprintf(stderr,"Cannot open %s!\n",filename);
+        MPI_Abort(comm,-1);
+    }
+    MPI_File_set_size(fh,0);
+    if (rank==0) {
+        init2DHeader(&h,X,Y);
+        MPI_File_write_at(fh,0,&h,sizeof(h),MPI_BYTE,MPI_STATUS_IGNORE);
+    }
+    n=set_rows_view(fh,x,X,Y,dist,comm);
+    MPI_File_write_all(fh,&localA[0][0],n*Y,MPI_DOUBLE,MPI_STATUS_IGNORE);
+    MPI_File_close(&fh);
+}
+
+//Every rank makes its own rows of a random X x Y matrix of the given kind
+//(RAND_MATRIX, RAND_RHS or RAND_SPD), the same rows for any number of ranks
+void random_rows(double ** localA, int x, int X, int Y, int dist, int kind, MPI_Comm comm) {
+    int rank,size,n;
+    MPI_Comm_size(comm,&size);
+    MPI_Comm_rank(comm,&rank);
+    n=real_rows(x,X,rank,size,dist);
+    if (dist==DIST_CYCLIC)
+        rand_rows(localA,n,rank,size,Y,kind);
+    else
+        rand_rows(localA,n,(long)rank*x,1,Y,kind);
+}
+
+//Fill the local rows from the first program argument. A binary matrix file
+//is read in parallel and a random array is made by every rank for its own
+//rows. With OUTPUT=text rank 0 needs the whole array anyway to print it to
+//filename, so it makes or reads all of it and scatters it.
+void input_rows(char * arg, double ** localA, int x, int X, int Y, int dist, char * filename, MPI_Comm comm) {
+    int rank,size;
+    double ** A=NULL;
+    FILE * fp;
+    MPI_Comm_size(comm,&size);
+    MPI_Comm_rank(comm,&rank);
+    if (output_mode()!=OUT_TEXT) {
+        if (input_is_file(arg))
+            read_rows(arg,localA,x,X,Y,dist,comm);
+        else
+            random_rows(localA,x,X,Y,dist,RAND_MATRIX,comm);
+        return;
+    }
+    if (rank==0) {
+        A=malloc2D(X,Y);
+        input2D(A,X,Y,arg);
+        if (output_mode()==OUT_TEXT) {
+            fp=fopen(filename,"w");
+            fprintf(fp,"\n****Initial Array****\n");
+            fclose(fp);
+            print2DFile(A,X,Y,filename);
+        }
+    }
+    scatter_rows(A,localA,x,X,Y,dist,comm);
+    if (rank==0)
+        free2D(A,X,Y);
+}
+
+//Write the final array in the requested output mode: binary files are
+//written in parallel, text output is gathered and printed by rank 0
+void output_rows(double ** localA, int x, int X, int Y, int dist, char * filename, MPI_Comm comm) {
+    int rank,size;
+    double ** A=NULL;
+    char * binname;
+    FILE * fp;
+    MPI_Comm_size(comm,&size);
+    MPI_Comm_rank(comm,&rank);
+    if (output_mode()==OUT_BINARY) {
+        binname=malloc(strlen(filename)+5);
+        sprintf(binname,"%s.bin",filename);
+        write_rows(binname,localA,x,X,Y,dist,comm);
+        free(binname);
+    }
+    else if (output_mode()==OUT_TEXT) {
+        if (rank==0)
+            A=malloc2D(X,Y);
+        gather_rows(localA,A,x,X,Y,dist,comm);
+        if (rank==0) {
+            fp=fopen(filename,"a");
+            fprintf(fp,"\n****Final Array****\n");
+            fclose(fp);
+            print2DFile(A,X,Y,filename);
+            free2D(A,X,Y);
+        }
+    }
+}
+
+//Solve LU*X=B with the factors and the N x nrhs right-hand sides
+//distributed by rows, X overwrites localB. Every solved row of B is
+//broadcast by its owner and applied at once to the rows of the same block
+//of SOLVE_NB rows, the rows outside the block are updated with the whole
+//block as a matrix-matrix product. Returns the communication time.
+double solve_dist(double ** localLU, int x, int N, double ** localB, int nrhs, int dist, MPI_Comm comm) {
+    int rank,size,i,j,k,p,kb,kend,i0,i1,owner;
+    double l,comm_time=0;
+    double ** W=malloc2D(SOLVE_NB,nrhs);
+    struct timeval time1,time2;
+    MPI_Comm_size(comm,&size);
+    MPI_Comm_rank(comm,&rank);
+
+    //Forward substitution L*Z=B
+    for (kb=0;kb<N;kb+=SOLVE_NB) {
+        kend=MIN(kb+SOLVE_NB,N);
+        for (k=kb;k<kend;k++) {
+            owner=row_owner(k,x,size,dist);
+            if (rank==owner)
+                for (j=0;j<nrhs;j++)
+                    W[k-kb][j]=localB[row_local(k,x,size,dist)][j];
+            gettimeofday(&time1,NULL);
+            MPI_Bcast(W[k-kb],nrhs,MPI_DOUBLE,owner,comm);
+            gettimeofday(&time2,NULL);
+            comm_time+=time2.tv_sec-time1.tv_sec+(time2.tv_usec-time1.tv_usec)*0.000001;
+            row_range(k+1,kend,x,rank,size,dist,&i0,&i1);
+            for (i=i0;i<i1;i++) {
+                l=localLU[i][k];
+                for (j=0;j<nrhs;j++)
+                    localB[i][j]-=l*W[k-kb][j];
+            }
+        }
+        row_range(kend,N,x,rank,size,dist,&i0,&i1);
+        for (i=i0;i<i1;i++)
+            for (p=kb;p<kend;p++) {
+                l=localLU[i][p];
+                for (j=0;j<nrhs;j++)
+                    localB[i][j]-=l*W[p-kb][j];
+            }
+    }
+
+    //Back substitution U*X=Z
+    for (kend=N;kend>0;kend-=SOLVE_NB) {
+        kb=MAX(kend-SOLVE_NB,0);
+        for (k=kend-1;k>=kb;k--) {
+            owner=row_owner(k,x,size,dist);
+            if (rank==owner) {
+                i=row_local(k,x,size,dist);
+                l=1.0/localLU[i][k];
+                for (j=0;j<nrhs;j++) {
+                    localB[i][j]*=l;
+                    W[k-kb][j]=localB[i][j];
+                }
+            }
+            gettimeofday(&time1,NULL);
+            MPI_Bcast(W[k-kb],nrhs,MPI_DOUBLE,owner,comm);
+            gettimeofday(&time2,NULL);
+            comm_time+=time2.tv_sec-time1.tv_sec+(time2.tv_usec-time1.tv_usec)*0.000001;
+            row_range(kb,k,x,rank,size,dist,&i0,&i1);
+            for (i=i0;i<i1;i++) {
+                l=localLU[i][k];
+                for (j=0;j<nrhs;j++)
+                    localB[i][j]-=l*W[k-kb][j];
+            }
+        }
+        row_range(0,kb,x,rank,size,dist,&i0,&i1);
+        for (i=i0;i<i1;i++)
+            for (p=kb;p<kend;p++) {
+                l=localLU[i][p];
+                for (j=0;j<nrhs;j++)
+                    localB[i][j]-=l*W[p-kb][j];
+            }
+    }
+
+    free2D(W,SOLVE_NB,nrhs);
+    return comm_time;
+}
+
+//Solve U^T*U*X=B with the Cholesky factor U on and above the diagonal of
+//the distributed rows, X overwrites localB. Column k of U is spread over
+//all ranks, so in the forward substitution every rank sums U[p][k]*z[p]
+//over its solved rows p and row k gets the sums with a reduction to its
+//owner. The back substitution broadcasts every solved row of X. Returns
+//the communication time.
+double solve_chol_dist(double ** localU, int x, int N, double ** localB, int nrhs, int dist, MPI_Comm comm) {
+    int rank,size,i,j,k,p,owner;
+    double u,comm_time=0;
+    //Partial sums of the forward substitution, then the replicated X
+    double ** S=malloc2D(N,nrhs);
+    double * w=malloc(nrhs*sizeof(double));
+    struct timeval time1,time2;
+    MPI_Comm_size(comm,&size);
+    MPI_Comm_rank(comm,&rank);
+
+    //U^T*Z=B
+    for (k=0;k<N;k++) {
+        owner=row_owner(k,x,size,dist);
+        gettimeofday(&time1,NULL);
+        MPI_Reduce(S[k],w,nrhs,MPI_DOUBLE,MPI_SUM,owner,comm);
+        gettimeofday(&time2,NULL);
+        comm_time+=time2.tv_sec-time1.tv_sec+(time2.tv_usec-time1.tv_usec)*0.000001;
+        if (rank==owner) {
+            i=row_local(k,x,size,dist);
+            u=1.0/localU[i][k];
+            for (j=0;j<nrhs;j++)
+                localB[i][j]=(localB[i][j]-w[j])*u;
+            for (p=k+1;p<N;p++) {
+                u=localU[i][p];
+                for (j=0;j<nrhs;j++)
+                    S[p][j]+=u*localB[i][j];
+            }
+        }
+    }
+
+    //U*X=Z
+    for (k=N-1;k>=0;k--) {
+        owner=row_owner(k,x,size,dist);
+        if (rank==owner) {
+            i=row_local(k,x,size,dist);
+            for (j=0;j<nrhs;j++)
+                w[j]=localB[i][j];
+            for (p=k+1;p<N;p++) {
+                u=localU[i][p];
+                for (j=0;j<nrhs;j++)
+                    w[j]-=u*S[p][j];
+            }
+            u=1.0/localU[i][k];
+            for (j=0;j<nrhs;j++) {
+                w[j]*=u;
+                localB[i][j]=w[j];
+            }
+        }
+        gettimeofday(&time1,NULL);
+        MPI_Bcast(w,nrhs,MPI_DOUBLE,owner,comm);
+        gettimeofday(&time2,NULL);
+        comm_time+=time2.tv_sec-time1.tv_sec+(time2.tv_usec-time1.tv_usec)*0.000001;
+        for (j=0;j<nrhs;j++)
+            S[k][j]=w[j];
+    }
+
+    free2D(S,N,nrhs);
+    free(w);
+    return comm_time;
+}
+
+//Distributed version of residual2D for the original rows localA, the
+//solution localX and the right-hand sides localB of every rank. Only the
+//solution is replicated, the result is returned on all ranks.
+double residual_dist(double ** localA, double ** localX, double ** localB, int x, int N, int nrhs, int dist, MPI_Comm comm) {
+    int rank,size,i,j,p,n;
+    double r,in[3]={0,0,0},out[3];
+    double ** X, * row=malloc(nrhs*sizeof(double));
+    MPI_Comm_size(comm,&size);
+    MPI_Comm_rank(comm,&rank);
+    X=malloc2D(N,nrhs);
+    gather_rows(localX,X,x,N,nrhs,dist,comm);
+    MPI_Bcast(&X[0][0],N*nrhs,MPI_DOUBLE,0,comm);
+    n=real_rows(x,N,rank,size,dist);
+    for (i=0;i<n;i++) {
+        for (j=0;j<nrhs;j++)
+            row[j]=-localB[i][j];
+        for (p=0;p<N;p++) {
+            if (fabs(localA[i][p])>in[0])
+                in[0]=fabs(localA[i][p]);
+            for (j=0;j<nrhs;j++)
+                row[j]+=localA[i][p]*X[p][j];
+        }
+        for (j=0;j<nrhs;j++) {
+            r=fabs(row[j]);
+            if (r>in[1])
+                in[1]=r;
+            if (fabs(localX[i][j])>in[2])
+                in[2]=fabs(localX[i][j]);
+        }
+    }
+    MPI_Allreduce(in,out,3,MPI_DOUBLE,MPI_MAX,comm);
+    free2D(X,N,nrhs);
+    free(row);
+    if (out[0]==0 || out[2]==0)
+        return out[1];
+    return out[1]/(out[0]*out[2]*N);
+}
+
+//Distributed version of verify2D for the original rows localA and the
+//factored rows localLU of every rank. Every rank makes the probe vector
+//itself, only U*v is exchanged; the result is returned on all ranks.
+double verify_dist(double ** localA, double ** localLU, int x, int N, int dist, MPI_Comm comm) {
+    int rank,size,i,j,g,n;
+    double s,in[3]={0,0,0},out[3];
+    double * v=malloc(N*sizeof(double)), ** localW=malloc2D(x,1), ** W=malloc2D(N,1);
+    MPI_Comm_size(comm,&size);
+    MPI_Comm_rank(comm,&rank);
+    if (v==NULL) {
+        fprintf(stderr,"Malloc failed!\n");
+        MPI_Abort(comm,-1);
+    }
+    for (j=0;j<N;j++) {
+        v[j]=rand_entry(RAND_PROBE,j,0);
+        if (v[j]>in[2])
+            in[2]=v[j];
+    }
+    n=real_rows(x,N,rank,size,dist);
+    for (i=0;i<n;i++) {
+        g=dist==DIST_CYCLIC ? i*size+rank : rank*x+i;
+        s=0;
+        for (j=g;j<N;j++)
+            s+=localLU[i][j]*v[j];
+        localW[i][0]=s;
+    }
+    gather_rows(localW,W,x,N,1,dist,comm);
+    MPI_Bcast(&W[0][0],N,MPI_DOUBLE,0,comm);
+    for (i=0;i<n;i++) {
+        g=dist==DIST_CYCLIC ? i*size+rank : rank*x+i;
+        s=W[g][0];
+        for (j=0;j<g;j++)
+            s+=localLU[i][j]*W[j][0];
+        for (j=0;j<N;j++) {
+            s-=localA[i][j]*v[j];
+            if (fabs(localA[i][j])>in[0])
+                in[0]=fabs(localA[i][j]);
+        }
+        //A NaN from a zero pivot fails the check
+        if (!(fabs(s)<=in[1]))
+            in[1]=isnan(s) ? HUGE_VAL : fabs(s);
+    }
+    MPI_Allreduce(in,out,3,MPI_DOUBLE,MPI_MAX,comm);
+    free2D(localW,x,1);
+    free2D(W,N,1);
+    free(v);
+    if (out[0]==0 || out[2]==0)
+        return out[1];
+    return out[1]/(out[0]*out[2]*N);
+}
@@ -0,0 +1,44 @@
+/**************************************************
+# Copyright (C) 2014 Raptis Dimos <raptis.dimos@yahoo.gr>
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+# **************************************************/
+
+#include <mpi.h>
+
+//Pivot row distribution modes of the p2p variants
+#define RELAY_LOOP 0
+#define RELAY_RING 1
+#define RELAY_TREE 2
+
+int relay_mode(char * name);
+char * relay_name(int mode);
+int relay_max_requests(int count, int segment);
+void relay_segment(double * row, int offset, int count, int root, int mode, MPI_Comm comm, MPI_Request * reqs, int * nreqs);
+
+//MPI_Pcontrol level that tells the tracer (mpi_trace.c) the pivot step
+#define TRACE_STEP 3
+
+//Row distributions of the MPI variants
+#define DIST_BLOCK 0
+#define DIST_CYCLIC 1
+
+void scatter_rows(double ** A, double ** localA, int x, int X, int Y, int dist, MPI_Comm comm);
+void gather_rows(double ** localA, double ** A, int x, int X, int Y, int dist, MPI_Comm comm);
+void read_rows(char * filename, double ** localA, int x, int X, int Y, int dist, MPI_Comm comm);
+void write_rows(char * filename, double ** localA, int x, int X, int Y, int dist, MPI_Comm comm);
+void random_rows(double ** localA, int x, int X, int Y, int dist, int kind, MPI_Comm comm);
+void input_rows(char * arg, double ** localA, int x, int X, int Y, int dist, char * filename, MPI_Comm comm);
+void output_rows(double ** localA, int x, int X, int Y, int dist, char * filename, MPI_Comm comm);
+double solve_dist(double ** localLU, int x, int N, double ** localB, int nrhs, int dist, MPI_Comm comm);
+double solve_chol_dist(double ** localU, int x, int N, double ** localB, int nrhs, int dist, MPI_Comm comm);
+double residual_dist(double ** localA, double ** localX, double ** localB, int x, int N, int nrhs, int dist, MPI_Comm comm);
+double verify_dist(double ** localA, double ** localLU, int x, int N, int dist, MPI_Comm comm);
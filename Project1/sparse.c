@@ -0,0 +1,931 @@
+/**************************************************
+# Copyright (C) 2014 Raptis Dimos <raptis.dimos@yahoo.gr>
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+# **************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "utils.h"
+#include "sparse.h"
+
+#ifdef _OPENMP
+#define OMP(x) _Pragma(#x)
+#else
+#define OMP(x)
+#endif
+
+//Nested dissection stops at parts of ND_LEAF nodes
+#define ND_LEAF 64
+//Supernodes narrower than RELAX absorb the next column even if its
+//structure differs, which adds some explicit zeros but fewer, larger fronts
+#define RELAX 8
+//Smallest subtree (or front update) worth its own task, in flops
+#define TASK_MIN (64*64*64)
+
+static void * xmalloc(size_t size) {
+    void * p=malloc(size);
+    if (p==NULL && size>0) {
+        fprintf(stderr,"Malloc failed!\n");
+        exit(-1);
+    }
+    return p;
+}
+
+static int cmp_int(const void * a, const void * b) {
+    return *(const int *)a-*(const int *)b;
+}
+
+void csr_alloc(csr_t * A, int n, int nnz) {
+    A->n=n;
+    A->nnz=nnz;
+    A->ptr=calloc(n+1,sizeof(int));
+    if (A->ptr==NULL) {
+        fprintf(stderr,"Malloc failed!\n");
+        exit(-1);
+    }
+    A->ind=xmalloc(nnz*sizeof(int));
+    A->val=xmalloc(nnz*sizeof(double));
+}
+
+void csr_free(csr_t * A) {
+    free(A->ptr);
+    free(A->ind);
+    free(A->val);
+}
+
+//A^T, or A in compressed sparse columns. Rows are filled in order, so the
+//result has sorted rows even if A does not.
+void csr_transpose(csr_t * A, csr_t * T) {
+    int i,e,q,n=A->n;
+    int * next=xmalloc(n*sizeof(int));
+    csr_alloc(T,n,A->nnz);
+    for (e=0;e<A->nnz;e++)
+        T->ptr[A->ind[e]+1]++;
+    for (i=0;i<n;i++)
+        T->ptr[i+1]+=T->ptr[i];
+    memcpy(next,T->ptr,n*sizeof(int));
+    for (i=0;i<n;i++)
+        for (e=A->ptr[i];e<A->ptr[i+1];e++) {
+            q=next[A->ind[e]]++;
+            T->ind[q]=i;
+            T->val[q]=A->val[e];
+        }
+    free(next);
+}
+
+//Sort the rows of A by transposing twice, then add up duplicate entries
+static void csr_sort(csr_t * A) {
+    csr_t T,S;
+    int i,e,k=0,start;
+    csr_transpose(A,&T);
+    csr_transpose(&T,&S);
+    csr_free(&T);
+    csr_free(A);
+    for (i=0;i<S.n;i++) {
+        start=S.ptr[i];
+        S.ptr[i]=k;
+        for (e=start;e<S.ptr[i+1];e++) {
+            if (k>S.ptr[i] && S.ind[k-1]==S.ind[e])
+                S.val[k-1]+=S.val[e];
+            else {
+                S.ind[k]=S.ind[e];
+                S.val[k]=S.val[e];
+                k++;
+            }
+        }
+    }
+    S.ptr[S.n]=k;
+    S.nnz=k;
+    *A=S;
+}
+
+//5-point stencil on a grid of sqrt(N) columns, the pattern of our
+//simulation meshes. Off-diagonal values are random in (-1,0] and the
+//diagonal is larger than the sum of the row.
+void csr_grid(csr_t * A, int N) {
+    int i,k=0,kd,nx=(int)sqrt((double)N);
+    double v,d;
+    if (nx<1)
+        nx=1;
+    csr_alloc(A,N,5*N);
+    for (i=0;i<N;i++) {
+        A->ptr[i]=k;
+        d=1.0;
+        kd=-1;
+        if (i-nx>=0) {
+            v=rand_entry(RAND_MATRIX,i,i-nx)/10.0;
+            A->ind[k]=i-nx;
+            A->val[k++]=-v;
+            d+=v;
+        }
+        if (i%nx!=0) {
+            v=rand_entry(RAND_MATRIX,i,i-1)/10.0;
+            A->ind[k]=i-1;
+            A->val[k++]=-v;
+            d+=v;
+        }
+        kd=k++;
+        A->ind[kd]=i;
+        if ((i+1)%nx!=0 && i+1<N) {
+            v=rand_entry(RAND_MATRIX,i,i+1)/10.0;
+            A->ind[k]=i+1;
+            A->val[k++]=-v;
+            d+=v;
+        }
+        if (i+nx<N) {
+            v=rand_entry(RAND_MATRIX,i,i+nx)/10.0;
+            A->ind[k]=i+nx;
+            A->val[k++]=-v;
+            d+=v;
+        }
+        A->val[kd]=d;
+    }
+    A->ptr[N]=k;
+    A->nnz=k;
+}
+
+//Matrix Market coordinate file (real, integer or pattern; general,
+//symmetric or skew-symmetric), duplicate entries are added up
+void read_mtx(char * filename, csr_t * A) {
+    FILE * fp=fopen(filename,"r");
+    char line[1024],object[64],format[64],field[64],symmetry[64];
+    int rows,cols,entries,i,j,k,e,pattern,mirror;
+    int * ri, * ci;
+    double v,sign=1;
+    double * rv;
+    if (fp==NULL) {
+        fprintf(stderr,"Cannot open %s!\n",filename);
+        exit(-1);
+    }
+    if (fgets(line,sizeof(line),fp)==NULL ||
+            sscanf(line,"%%%%MatrixMarket %63s %63s %63s %63s",object,format,field,symmetry)!=4 ||
+            strcmp(format,"coordinate")!=0 || strcmp(field,"complex")==0) {
+        fprintf(stderr,"%s is not a real Matrix Market coordinate file!\n",filename);
+        exit(-1);
+    }
+    pattern=strcmp(field,"pattern")==0;
+    mirror=strcmp(symmetry,"general")!=0;
+    if (strcmp(symmetry,"skew-symmetric")==0)
+        sign=-1;
+    do {
+        if (fgets(line,sizeof(line),fp)==NULL) {
+            fprintf(stderr,"%s: missing size line!\n",filename);
+            exit(-1);
+        }
+    } while (line[0]=='%');
+    if (sscanf(line,"%d %d %d",&rows,&cols,&entries)!=3 || rows!=cols || rows<1) {
+        fprintf(stderr,"%s: the matrix is not square!\n",filename);
+        exit(-1);
+    }
+    ri=xmalloc(2*(size_t)entries*sizeof(int));
+    ci=xmalloc(2*(size_t)entries*sizeof(int));
+    rv=xmalloc(2*(size_t)entries*sizeof(double));
+    k=0;
+    for (e=0;e<entries;e++) {
+        v=1;
+        if (fscanf(fp,"%d %d",&i,&j)!=2 || (!pattern && fscanf(fp,"%lf",&v)!=1) ||
+                i<1 || i>rows || j<1 || j>cols) {
+            fprintf(stderr,"%s: bad entry %d!\n",filename,e+1);
+            exit(-1);
+        }
+        ri[k]=i-1;
+        ci[k]=j-1;
+        rv[k++]=v;
+        if (mirror && i!=j) {
+            ri[k]=j-1;
+            ci[k]=i-1;
+            rv[k++]=sign*v;
+        }
+    }
+    fclose(fp);
+
+    csr_alloc(A,rows,k);
+    for (e=0;e<k;e++)
+        A->ptr[ri[e]+1]++;
+    for (i=0;i<rows;i++)
+        A->ptr[i+1]+=A->ptr[i];
+    for (e=0;e<k;e++) {
+        j=A->ptr[ri[e]]++;
+        A->ind[j]=ci[e];
+        A->val[j]=rv[e];
+    }
+    for (i=rows;i>0;i--)
+        A->ptr[i]=A->ptr[i-1];
+    A->ptr[0]=0;
+    free(ri);
+    free(ci);
+    free(rv);
+    csr_sort(A);
+}
+
+//Pattern of A+A^T without the diagonal, as adjacency lists
+static void graph(csr_t * A, int ** xadj, int ** adj) {
+    csr_t T;
+    int i,a,b,k,pass,n=A->n;
+    csr_transpose(A,&T);
+    *xadj=xmalloc((n+1)*sizeof(int));
+    *adj=NULL;
+    //Count the merged rows of A and A^T, then fill them
+    for (pass=0;pass<2;pass++) {
+        k=0;
+        for (i=0;i<n;i++) {
+            (*xadj)[i]=k;
+            a=A->ptr[i];
+            b=T.ptr[i];
+            while (a<A->ptr[i+1] || b<T.ptr[i+1]) {
+                int j;
+                if (b>=T.ptr[i+1] || (a<A->ptr[i+1] && A->ind[a]<T.ind[b]))
+                    j=A->ind[a++];
+                else if (a>=A->ptr[i+1] || T.ind[b]<A->ind[a])
+                    j=T.ind[b++];
+                else {
+                    j=A->ind[a++];
+                    b++;
+                }
+                if (j==i)
+                    continue;
+                if (pass)
+                    (*adj)[k]=j;
+                k++;
+            }
+        }
+        (*xadj)[n]=k;
+        if (!pass)
+            *adj=xmalloc(k*sizeof(int));
+    }
+    csr_free(&T);
+}
+
+//Nested dissection state, where[] and seen[] hold the stamp of the region
+//and of the breadth-first search a node last belonged to
+typedef struct {
+    int * xadj;
+    int * adj;
+    int * where;
+    int * seen;
+    int * level;
+    int * queue;
+    int * perm;
+    int region;
+    int search;
+} nd_t;
+
+//Breadth-first search inside the region from root, the nodes end up in
+//queue in level order. Returns the number of nodes reached.
+static int bfs(nd_t * g, int root, int region) {
+    int head=0,tail=0,v,u,e,mark=++g->search;
+    g->seen[root]=mark;
+    g->level[root]=0;
+    g->queue[tail++]=root;
+    while (head<tail) {
+        v=g->queue[head++];
+        for (e=g->xadj[v];e<g->xadj[v+1];e++) {
+            u=g->adj[e];
+            if (g->where[u]==region && g->seen[u]!=mark) {
+                g->seen[u]=mark;
+                g->level[u]=g->level[v]+1;
+                g->queue[tail++]=u;
+            }
+        }
+    }
+    return tail;
+}
+
+//Number the cnt nodes with lo..lo+cnt-1: the two halves left by a level
+//separator first (recursively), the separator last
+static void nd(nd_t * g, int * nodes, int cnt, int lo) {
+    int i,e,v,u,m,depth,reached,region,na=0,nb=0,ns=0,pass,side;
+    int * tmp, * sizes;
+    if (cnt<=ND_LEAF) {
+        for (i=0;i<cnt;i++)
+            g->perm[lo+i]=nodes[i];
+        return;
+    }
+    region=++g->region;
+    for (i=0;i<cnt;i++)
+        g->where[nodes[i]]=region;
+
+    //Pseudo-peripheral root: the farthest node from the first one
+    reached=bfs(g,nodes[0],region);
+    reached=bfs(g,g->queue[reached-1],region);
+    tmp=xmalloc(cnt*sizeof(int));
+
+    //Disconnected region: every component is ordered on its own
+    if (reached<cnt) {
+        sizes=xmalloc(cnt*sizeof(int));
+        m=0;
+        for (i=0;i<cnt;i++) {
+            v=nodes[i];
+            if (g->where[v]!=region)
+                continue;
+            reached=bfs(g,v,region);
+            memcpy(&tmp[ns],g->queue,reached*sizeof(int));
+            for (e=0;e<reached;e++)
+                g->where[g->queue[e]]=0;
+            ns+=reached;
+            sizes[m++]=reached;
+        }
+        memcpy(nodes,tmp,cnt*sizeof(int));
+        free(tmp);
+        for (i=0,ns=0;i<m;i++) {
+            nd(g,&nodes[ns],sizes[i],lo+ns);
+            ns+=sizes[i];
+        }
+        free(sizes);
+        return;
+    }
+
+    depth=g->level[g->queue[cnt-1]];
+    if (depth<2) {
+        free(tmp);
+        for (i=0;i<cnt;i++)
+            g->perm[lo+i]=nodes[i];
+        return;
+    }
+    //Separator: the level that holds the median node. Separator nodes
+    //without a neighbour in the next level go to the first half.
+    m=g->level[g->queue[cnt/2]];
+    if (m==0)
+        m=1;
+    if (m==depth)
+        m=depth-1;
+    for (pass=0;pass<3;pass++)
+        for (i=0;i<cnt;i++) {
+            v=g->queue[i];
+            if (g->level[v]<m)
+                side=0;
+            else if (g->level[v]>m)
+                side=1;
+            else {
+                side=0;
+                for (e=g->xadj[v];e<g->xadj[v+1];e++) {
+                    u=g->adj[e];
+                    if (g->where[u]==region && g->level[u]==m+1) {
+                        side=2;
+                        break;
+                    }
+                }
+            }
+            if (side!=pass)
+                continue;
+            tmp[na+nb+ns]=v;
+            if (side==0)
+                na++;
+            else if (side==1)
+                nb++;
+            else
+                ns++;
+        }
+    memcpy(nodes,tmp,cnt*sizeof(int));
+    free(tmp);
+    for (i=0;i<ns;i++)
+        g->perm[lo+na+nb+i]=nodes[na+nb+i];
+    nd(g,nodes,na,lo);
+    nd(g,&nodes[na],nb,lo+na);
+}
+
+//perm[k] is the row and column of A eliminated at step k
+void order_sparse(csr_t * A, int ordering, int * perm) {
+    int i,n=A->n;
+    nd_t g;
+    int * nodes;
+    if (ordering==ORDER_NATURAL) {
+        for (i=0;i<n;i++)
+            perm[i]=i;
+        return;
+    }
+    graph(A,&g.xadj,&g.adj);
+    g.where=calloc(n,sizeof(int));
+    g.seen=calloc(n,sizeof(int));
+    if (g.where==NULL || g.seen==NULL) {
+        fprintf(stderr,"Malloc failed!\n");
+        exit(-1);
+    }
+    g.level=xmalloc(n*sizeof(int));
+    g.queue=xmalloc(n*sizeof(int));
+    g.perm=perm;
+    g.region=0;
+    g.search=0;
+    nodes=xmalloc(n*sizeof(int));
+    for (i=0;i<n;i++)
+        nodes[i]=i;
+    nd(&g,nodes,n,0);
+    free(nodes);
+    free(g.xadj);
+    free(g.adj);
+    free(g.where);
+    free(g.seen);
+    free(g.level);
+    free(g.queue);
+}
+
+//Elimination tree, column counts, supernodes and the row structure of
+//every supernode, in the pivot numbering. The structure of a supernode is
+//that of its columns in A+A^T plus the rows its children pass up.
+void symbolic(csr_t * A, int * perm, sym_t * S) {
+    int i,j,k,e,s,c,n=A->n,w,r,m,cap,width;
+    int * xadj, * adj;
+    int * parent=xmalloc(n*sizeof(int)), * ancestor=xmalloc(n*sizeof(int));
+    int * cc=calloc(n,sizeof(int)), * mark=xmalloc(n*sizeof(int)), * snode=xmalloc(n*sizeof(int));
+    int * head, * next;
+    double f;
+    if (cc==NULL) {
+        fprintf(stderr,"Malloc failed!\n");
+        exit(-1);
+    }
+    graph(A,&xadj,&adj);
+    S->n=n;
+    S->perm=xmalloc(n*sizeof(int));
+    S->iperm=xmalloc(n*sizeof(int));
+    memcpy(S->perm,perm,n*sizeof(int));
+    for (k=0;k<n;k++)
+        S->iperm[perm[k]]=k;
+
+    //Elimination tree with path compression
+    for (k=0;k<n;k++) {
+        parent[k]=-1;
+        ancestor[k]=-1;
+        for (e=xadj[perm[k]];e<xadj[perm[k]+1];e++) {
+            i=S->iperm[adj[e]];
+            while (i!=-1 && i<k) {
+                j=ancestor[i];
+                ancestor[i]=k;
+                if (j==-1)
+                    parent[i]=k;
+                i=j;
+            }
+        }
+    }
+
+    //Postorder of the tree, so that every subtree (and later every
+    //supernode subtree) is a range of consecutive pivots
+    head=xmalloc(n*sizeof(int));
+    next=xmalloc(n*sizeof(int));
+    for (k=0;k<n;k++)
+        head[k]=-1;
+    for (k=n-1;k>=0;k--)
+        if (parent[k]!=-1) {
+            next[k]=head[parent[k]];
+            head[parent[k]]=k;
+        }
+    for (k=0,j=0,c=0;k<n;k++) {
+        if (parent[k]!=-1)
+            continue;
+        snode[c++]=k;
+        while (c>0) {
+            i=snode[c-1];
+            if (head[i]==-1) {
+                c--;
+                cc[j++]=i;
+            }
+            else {
+                snode[c++]=head[i];
+                head[i]=next[head[i]];
+            }
+        }
+    }
+    for (k=0;k<n;k++) {
+        S->perm[k]=perm[cc[k]];
+        mark[cc[k]]=k;
+    }
+    for (k=0;k<n;k++) {
+        S->iperm[S->perm[k]]=k;
+        ancestor[k]=parent[cc[k]]==-1 ? -1 : mark[parent[cc[k]]];
+    }
+    memcpy(parent,ancestor,n*sizeof(int));
+    free(head);
+    free(next);
+    perm=S->perm;
+    memset(cc,0,n*sizeof(int));
+
+    //Column counts: row k of L is the union of the tree paths from its
+    //entries up to k
+    for (k=0;k<n;k++) {
+        mark[k]=k;
+        for (e=xadj[perm[k]];e<xadj[perm[k]+1];e++) {
+            i=S->iperm[adj[e]];
+            if (i>k)
+                continue;
+            while (mark[i]!=k) {
+                cc[i]++;
+                mark[i]=k;
+                i=parent[i];
+            }
+        }
+    }
+
+    //Chains of the tree with nested structures form supernodes
+    S->sup=xmalloc((n+1)*sizeof(int));
+    S->nsuper=0;
+    S->sup[0]=0;
+    width=1;
+    for (j=1;j<n;j++) {
+        if (parent[j-1]==j && (cc[j-1]==cc[j]+1 || width<RELAX))
+            width++;
+        else {
+            S->sup[++S->nsuper]=j;
+            width=1;
+        }
+    }
+    S->sup[++S->nsuper]=n;
+    for (s=0;s<S->nsuper;s++)
+        for (j=S->sup[s];j<S->sup[s+1];j++)
+            snode[j]=s;
+
+    //Row structures, children before parents since parents come later
+    S->sparent=xmalloc(S->nsuper*sizeof(int));
+    S->rptr=xmalloc((S->nsuper+1)*sizeof(int));
+    S->work=calloc(S->nsuper,sizeof(double));
+    head=xmalloc(S->nsuper*sizeof(int));
+    next=xmalloc(S->nsuper*sizeof(int));
+    if (S->work==NULL) {
+        fprintf(stderr,"Malloc failed!\n");
+        exit(-1);
+    }
+    cap=n;
+    S->rind=xmalloc(cap*sizeof(int));
+    S->rptr[0]=0;
+    S->nnz=0;
+    S->flops=0;
+    S->maxfront=0;
+    for (k=0;k<n;k++)
+        mark[k]=-1;
+    for (s=0;s<S->nsuper;s++)
+        head[s]=-1;
+    for (s=0;s<S->nsuper;s++) {
+        int c0=S->sup[s],c1=S->sup[s+1],start=S->rptr[s];
+        r=0;
+        for (j=c0;j<c1;j++)
+            for (e=xadj[perm[j]];e<xadj[perm[j]+1];e++) {
+                i=S->iperm[adj[e]];
+                if (i>=c1 && mark[i]!=s) {
+                    mark[i]=s;
+                    if (start+r==cap) {
+                        cap*=2;
+                        S->rind=realloc(S->rind,cap*sizeof(int));
+                    }
+                    S->rind[start+r++]=i;
+                }
+            }
+        for (c=head[s];c!=-1;c=next[c])
+            for (e=S->rptr[c];e<S->rptr[c+1];e++) {
+                i=S->rind[e];
+                if (i>=c1 && mark[i]!=s) {
+                    mark[i]=s;
+                    if (start+r==cap) {
+                        cap*=2;
+                        S->rind=realloc(S->rind,cap*sizeof(int));
+                    }
+                    S->rind[start+r++]=i;
+                }
+            }
+        if (S->rind==NULL) {
+            fprintf(stderr,"Malloc failed!\n");
+            exit(-1);
+        }
+        qsort(&S->rind[start],r,sizeof(int),cmp_int);
+        S->rptr[s+1]=start+r;
+        S->sparent[s]=r>0 ? snode[S->rind[start]] : -1;
+        if (S->sparent[s]!=-1) {
+            next[s]=head[S->sparent[s]];
+            head[S->sparent[s]]=s;
+        }
+
+        //Size of the factors and flops of the partial factorization of the front
+        w=c1-c0;
+        m=w+r;
+        if (m>S->maxfront)
+            S->maxfront=m;
+        S->nnz+=(long)w*m+(long)r*w;
+        f=0;
+        for (k=0;k<w;k++)
+            f+=(double)(m-k-1)*(2*(m-k-1)+1);
+        S->flops+=f;
+        S->work[s]+=f;
+        if (S->sparent[s]!=-1)
+            S->work[S->sparent[s]]+=S->work[s];
+    }
+    free(xadj);
+    free(adj);
+    free(parent);
+    free(ancestor);
+    free(cc);
+    free(mark);
+    free(snode);
+    free(head);
+    free(next);
+}
+
+void sym_free(sym_t * S) {
+    free(S->perm);
+    free(S->iperm);
+    free(S->sup);
+    free(S->sparent);
+    free(S->rptr);
+    free(S->rind);
+    free(S->work);
+}
+
+//Shared state of the numeric factorization: A permuted by rows and by
+//columns, the children of every supernode and the update matrices the
+//children leave for their parent
+typedef struct {
+    csr_t * Ap;
+    csr_t * ApT;
+    sym_t * S;
+    num_t * F;
+    int * head;
+    int * next;
+    int * first;
+    double ** cb;
+} front_t;
+
+//Assemble the frontal matrix of supernode s from the entries of A and the
+//update matrices of its children, eliminate its w pivots and keep the
+//r x r update matrix of the rows below for the parent
+static void front(front_t * t, int s) {
+    sym_t * S=t->S;
+    int c0=S->sup[s],c1=S->sup[s+1],w=c1-c0,r=S->rptr[s+1]-S->rptr[s],m=w+r;
+    int i,j,k,e,p,a,b,c,rc;
+    int * R=&S->rind[S->rptr[s]], * I=xmalloc(m*sizeof(int)), * pos;
+    double ** Fm=malloc2D(m,m);
+    double * cb;
+
+    //Indices of the front: the pivots, then the rows below, all sorted
+    for (k=0;k<w;k++)
+        I[k]=c0+k;
+    for (k=0;k<r;k++)
+        I[w+k]=R[k];
+
+    //Rows of A from column c0 on and columns of A below the supernode
+    for (j=c0;j<c1;j++) {
+        p=0;
+        for (e=t->Ap->ptr[j];e<t->Ap->ptr[j+1];e++) {
+            c=t->Ap->ind[e];
+            if (c<c0)
+                continue;
+            while (I[p]<c)
+                p++;
+            Fm[j-c0][p]+=t->Ap->val[e];
+        }
+        p=w;
+        for (e=t->ApT->ptr[j];e<t->ApT->ptr[j+1];e++) {
+            c=t->ApT->ind[e];
+            if (c<c1)
+                continue;
+            while (I[p]<c)
+                p++;
+            Fm[p][j-c0]+=t->ApT->val[e];
+        }
+    }
+
+    //Extend-add the update matrices of the children
+    for (c=t->head[s];c!=-1;c=t->next[c]) {
+        rc=S->rptr[c+1]-S->rptr[c];
+        pos=xmalloc(rc*sizeof(int));
+        p=0;
+        for (a=0;a<rc;a++) {
+            while (I[p]<S->rind[S->rptr[c]+a])
+                p++;
+            pos[a]=p;
+        }
+        cb=t->cb[c];
+        for (a=0;a<rc;a++)
+            for (b=0;b<rc;b++)
+                Fm[pos[a]][pos[b]]+=cb[a*rc+b];
+        free(pos);
+        free(cb);
+        t->cb[c]=NULL;
+    }
+
+    //Partial factorization: the pivot rows first, then every row below
+    //with all of them while it stays in cache
+    for (k=0;k<w;k++)
+        for (i=k+1;i<w;i++)
+            eliminate_row(Fm[i],Fm[k],k,m);
+    OMP(omp taskloop private(k) if((double)r*w*m>=TASK_MIN))
+    for (i=w;i<m;i++)
+        for (k=0;k<w;k++)
+            eliminate_row(Fm[i],Fm[k],k,m);
+
+    t->F->top[s]=xmalloc((size_t)w*m*sizeof(double));
+    for (k=0;k<w;k++)
+        memcpy(&t->F->top[s][(size_t)k*m],Fm[k],m*sizeof(double));
+    t->F->low[s]=xmalloc((size_t)r*w*sizeof(double));
+    for (i=0;i<r;i++)
+        memcpy(&t->F->low[s][(size_t)i*w],Fm[w+i],w*sizeof(double));
+    if (r>0) {
+        cb=xmalloc((size_t)r*r*sizeof(double));
+        for (i=0;i<r;i++)
+            memcpy(&cb[(size_t)i*r],&Fm[w+i][w],r*sizeof(double));
+        t->cb[s]=cb;
+    }
+    free2D(Fm,m,m);
+    free(I);
+}
+
+//Factor the subtree of s. Subtrees below TASK_MIN are a range of
+//supernodes factored in order. Larger ones follow the heaviest child down
+//and leave the other children to tasks, so the recursion stays shallow
+//even when the tree is a long chain.
+static void factor_tree(front_t * t, int s) {
+    sym_t * S=t->S;
+    int c,h,p=s,q=s;
+    while (p!=-1 && S->work[p]>=TASK_MIN) {
+        h=-1;
+        for (c=t->head[p];c!=-1;c=t->next[c])
+            if (h==-1 || S->work[c]>S->work[h])
+                h=c;
+        for (c=t->head[p];c!=-1;c=t->next[c])
+            if (c!=h) {
+                OMP(omp task if(S->work[c]>=TASK_MIN))
+                factor_tree(t,c);
+            }
+        q=p;
+        p=h;
+    }
+    if (p!=-1) {
+        for (c=t->first[p];c<=p;c++)
+            front(t,c);
+        if (p==s)
+            return;
+    }
+    OMP(omp taskwait)
+    for (c=q;;c=S->sparent[c]) {
+        front(t,c);
+        if (c==s)
+            break;
+    }
+}
+
+void numeric(csr_t * A, sym_t * S, num_t * F) {
+    csr_t P,Ap,ApT;
+    front_t t;
+    int i,e,k=0,s,n=A->n;
+
+    //P*A*P^T, sorted by the two transposes
+    csr_alloc(&P,n,A->nnz);
+    for (i=0;i<n;i++) {
+        P.ptr[i]=k;
+        for (e=A->ptr[S->perm[i]];e<A->ptr[S->perm[i]+1];e++) {
+            P.ind[k]=S->iperm[A->ind[e]];
+            P.val[k++]=A->val[e];
+        }
+    }
+    P.ptr[n]=k;
+    csr_transpose(&P,&ApT);
+    csr_transpose(&ApT,&Ap);
+    csr_free(&P);
+
+    F->top=calloc(S->nsuper,sizeof(double *));
+    F->low=calloc(S->nsuper,sizeof(double *));
+    t.cb=calloc(S->nsuper,sizeof(double *));
+    t.head=xmalloc(S->nsuper*sizeof(int));
+    t.next=xmalloc(S->nsuper*sizeof(int));
+    t.first=xmalloc(S->nsuper*sizeof(int));
+    if (F->top==NULL || F->low==NULL || t.cb==NULL) {
+        fprintf(stderr,"Malloc failed!\n");
+        exit(-1);
+    }
+    //The subtree of s is the supernodes first[s]..s
+    for (s=0;s<S->nsuper;s++) {
+        t.head[s]=-1;
+        t.first[s]=s;
+    }
+    for (s=0;s<S->nsuper;s++)
+        if (S->sparent[s]!=-1 && t.first[s]<t.first[S->sparent[s]])
+            t.first[S->sparent[s]]=t.first[s];
+    for (s=S->nsuper-1;s>=0;s--)
+        if (S->sparent[s]!=-1) {
+            t.next[s]=t.head[S->sparent[s]];
+            t.head[S->sparent[s]]=s;
+        }
+    t.Ap=&Ap;
+    t.ApT=&ApT;
+    t.S=S;
+    t.F=F;
+
+    OMP(omp parallel)
+    OMP(omp single)
+    for (s=0;s<S->nsuper;s++)
+        if (S->sparent[s]==-1) {
+            OMP(omp task if(S->work[s]>=TASK_MIN))
+            factor_tree(&t,s);
+        }
+
+    csr_free(&Ap);
+    csr_free(&ApT);
+    free(t.cb);
+    free(t.head);
+    free(t.next);
+    free(t.first);
+}
+
+void num_free(sym_t * S, num_t * F) {
+    int s;
+    for (s=0;s<S->nsuper;s++) {
+        free(F->top[s]);
+        free(F->low[s]);
+    }
+    free(F->top);
+    free(F->low);
+}
+
+//Solve A*X=B with the supernodal factors, X overwrites B
+void solve_sparse(sym_t * S, num_t * F, double ** B, int nrhs) {
+    int s,k,i,j,t,w,r,m,c0,n=S->n;
+    int * R;
+    double l, * top, * low, * yk, * row;
+    double ** Y=malloc2D(n,nrhs);
+    for (k=0;k<n;k++)
+        memcpy(Y[k],B[S->perm[k]],nrhs*sizeof(double));
+
+    //L*Z=P*B, supernodes in increasing order
+    for (s=0;s<S->nsuper;s++) {
+        c0=S->sup[s];
+        w=S->sup[s+1]-c0;
+        r=S->rptr[s+1]-S->rptr[s];
+        m=w+r;
+        R=&S->rind[S->rptr[s]];
+        top=F->top[s];
+        low=F->low[s];
+        for (k=0;k<w;k++) {
+            yk=Y[c0+k];
+            for (i=k+1;i<w;i++) {
+                l=top[i*m+k];
+                for (j=0;j<nrhs;j++)
+                    Y[c0+i][j]-=l*yk[j];
+            }
+            for (i=0;i<r;i++) {
+                l=low[i*w+k];
+                for (j=0;j<nrhs;j++)
+                    Y[R[i]][j]-=l*yk[j];
+            }
+        }
+    }
+
+    //U*X=Z, supernodes in decreasing order
+    for (s=S->nsuper-1;s>=0;s--) {
+        c0=S->sup[s];
+        w=S->sup[s+1]-c0;
+        r=S->rptr[s+1]-S->rptr[s];
+        m=w+r;
+        R=&S->rind[S->rptr[s]];
+        top=F->top[s];
+        for (k=w-1;k>=0;k--) {
+            yk=Y[c0+k];
+            for (t=k+1;t<m;t++) {
+                l=top[k*m+t];
+                row=t<w ? Y[c0+t] : Y[R[t-w]];
+                for (j=0;j<nrhs;j++)
+                    yk[j]-=l*row[j];
+            }
+            l=1.0/top[k*m+k];
+            for (j=0;j<nrhs;j++)
+                yk[j]*=l;
+        }
+    }
+
+    for (k=0;k<n;k++)
+        memcpy(B[S->perm[k]],Y[k],nrhs*sizeof(double));
+    free2D(Y,n,nrhs);
+}
+
+//Scaled residual max|A*X-B|/(max|A|*max|X|*N), as residual2D
+double residual_sparse(csr_t * A, double ** X, double ** B, int nrhs) {
+    int i,j,e,n=A->n;
+    double r,rmax=0,amax=0,xmax=0;
+    double * row=xmalloc(nrhs*sizeof(double));
+    for (i=0;i<n;i++) {
+        for (j=0;j<nrhs;j++)
+            row[j]=-B[i][j];
+        for (e=A->ptr[i];e<A->ptr[i+1];e++) {
+            if (fabs(A->val[e])>amax)
+                amax=fabs(A->val[e]);
+            for (j=0;j<nrhs;j++)
+                row[j]+=A->val[e]*X[A->ind[e]][j];
+        }
+        for (j=0;j<nrhs;j++) {
+            r=fabs(row[j]);
+            if (r>rmax)
+                rmax=r;
+            if (fabs(X[i][j])>xmax)
+                xmax=fabs(X[i][j]);
+        }
+    }
+    free(row);
+    if (amax==0 || xmax==0)
+        return rmax;
+    return rmax/(amax*xmax*n);
+}
@@ -0,0 +1,77 @@
+/**************************************************
+# Copyright (C) 2014 Raptis Dimos <raptis.dimos@yahoo.gr>
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+# **************************************************/
+
+#ifndef SPARSE_H__
+#define SPARSE_H__
+
+//Sparse LU without pivoting: fill-reducing ordering of the pattern of
+//A+A^T, symbolic analysis on its elimination tree and a supernodal
+//multifrontal numeric factorization, the subtrees of the supernode tree
+//are openMP tasks.
+
+//Compressed sparse rows, columns sorted within a row. The same arrays
+//read as compressed sparse columns hold A^T.
+typedef struct {
+    int n;
+    int nnz;
+    int * ptr;
+    int * ind;
+    double * val;
+} csr_t;
+
+//Orderings
+#define ORDER_NATURAL 0
+#define ORDER_ND 1
+
+//Symbolic factorization: pivot k is row and column perm[k] of A, the
+//ordering followed by a postorder of the elimination tree. Supernode
+//s holds the pivots sup[s]..sup[s+1]-1, the rows of L (columns of U) below
+//them are rind[rptr[s]..rptr[s+1]), sorted, in pivot numbering.
+typedef struct {
+    int n;
+    int nsuper;
+    int * perm;
+    int * iperm;
+    int * sup;
+    int * sparent;
+    int * rptr;
+    int * rind;
+    double * work;          //flops of the subtree of every supernode
+    long nnz;               //entries of L+U
+    double flops;
+    int maxfront;
+} sym_t;
+
+//Factors of every supernode of w pivots with r rows below: top[s] is the
+//w x (w+r) block row of U (L of the diagonal block below its diagonal),
+//low[s] the r x w block of L under it, both row-major
+typedef struct {
+    double ** top;
+    double ** low;
+} num_t;
+
+void csr_alloc(csr_t * A, int n, int nnz);
+void csr_free(csr_t * A);
+void csr_grid(csr_t * A, int N);
+void read_mtx(char * filename, csr_t * A);
+void csr_transpose(csr_t * A, csr_t * T);
+void order_sparse(csr_t * A, int ordering, int * perm);
+void symbolic(csr_t * A, int * perm, sym_t * S);
+void sym_free(sym_t * S);
+void numeric(csr_t * A, sym_t * S, num_t * F);
+void num_free(sym_t * S, num_t * F);
+void solve_sparse(sym_t * S, num_t * F, double ** B, int nrhs);
+double residual_sparse(csr_t * A, double ** X, double ** B, int nrhs);
+
+#endif  /* SPARSE_H__ */
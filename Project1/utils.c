@@ -14,42 +14,148 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#include "utils.h"
 
-double ** malloc2D(int X, int Y) {
- 	int i,j;
-	double **a;
-	
-	a=malloc(X*sizeof(double*));
-    if (a==NULL) {
+//Row block of the triangular solves
+#define SOLVE_NB 64
+
+#define MIN(a,b) ((a)<(b)?(a):(b))
+
+//Row alignment, the leading dimension to avoid, pages and huge pages
+#define ALIGN 64
+#define ALIAS 4096
+#define PAGE 4096
+#define HUGE_PAGE (2<<20)
+#define HUGE_MIN (4<<20)
+
+//Arrays of HUGE_MIN bytes or more are mapped on their own, aligned to a
+//huge page and advised to use huge pages. Their pages are zero and
+//untouched until the first write, which decides the NUMA node of each one.
+//Smaller arrays are aligned to a cache line.
+static void * alloc2D(size_t bytes, size_t * mapped) {
+    void * p;
+    char * m, * a;
+    size_t len;
+    if (bytes>=HUGE_MIN) {
+        bytes=(bytes+PAGE-1)&~(size_t)(PAGE-1);
+        len=bytes+HUGE_PAGE;
+        m=mmap(NULL,len,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS,-1,0);
+        if (m==MAP_FAILED) {
+            fprintf(stderr,"Malloc failed!\n");
+            exit(-1);
+        }
+        a=(char *)(((uintptr_t)m+HUGE_PAGE-1)&~(uintptr_t)(HUGE_PAGE-1));
+        if (a>m)
+            munmap(m,a-m);
+        if (m+len>a+bytes)
+            munmap(a+bytes,m+len-(a+bytes));
+#ifdef MADV_HUGEPAGE
+        madvise(a,bytes,MADV_HUGEPAGE);
+#endif
+        *mapped=bytes;
+        return a;
+    }
+    if (posix_memalign(&p,ALIGN,bytes>0 ? bytes : ALIGN)!=0) {
         fprintf(stderr,"Malloc failed!\n");
         exit(-1);
     }
-	a[0]=calloc(X*Y,sizeof(double));
-    if (a[0]==NULL) {
+    memset(p,0,bytes);
+    *mapped=0;
+    return p;
+}
+
+//X rows of ld elements, Y of them in use. Two hidden pointers before the
+//rows keep the block and its mapped length for free2D.
+static double ** rows2D(int X, int Y, int ld) {
+    int i;
+    size_t mapped;
+    double ** h=malloc((X+2)*sizeof(double *));
+    if (h==NULL) {
         fprintf(stderr,"Malloc failed!\n");
         exit(-1);
     }
+    h[0]=alloc2D((size_t)X*ld*sizeof(double),&mapped);
+    h[1]=(double *)(uintptr_t)mapped;
+    for (i=0;i<X;i++)
+        h[i+2]=h[0]+(size_t)i*ld;
+    return h+2;
+}
 
-	for (i=1;i<X;i++)
-		a[i]=a[i-1]+Y;	
-	return a;
+//Zeroed X x Y array with contiguous rows, a[0] is the whole array
+double ** malloc2D(int X, int Y) {
+    return rows2D(X,Y,Y);
+}
+
+//Zeroed X x Y array for programs that only go through the row pointers:
+//every row starts on a cache line and the leading dimension is padded so
+//that rows are not a multiple of ALIAS bytes apart, which would map the
+//same column of consecutive rows to the same cache sets
+double ** malloc2DPadded(int X, int Y) {
+    int ld=(Y+ALIGN/sizeof(double)-1)&~(int)(ALIGN/sizeof(double)-1);
+    if ((ld*sizeof(double))%ALIAS==0)
+        ld+=ALIGN/sizeof(double);
+    return rows2D(X,Y,ld);
 }
 
 void free2D(double ** a, int X, int Y) {
+    double ** h=a-2;
+    if ((uintptr_t)h[1]>0)
+        munmap(h[0],(uintptr_t)h[1]);
+    else
+        free(h[0]);
+    free(h);
+}
+
+//Single precision array with the same layout and allocation as malloc2D,
+//for the mixed precision LU
+float ** malloc2Df(int X, int Y) {
     int i;
-    if (X>1) {
-        for (i=1;i<X;i++)
-            a[i]=NULL;
+    size_t mapped;
+    float ** h=malloc((X+2)*sizeof(float *));
+    if (h==NULL) {
+        fprintf(stderr,"Malloc failed!\n");
+        exit(-1);
     }
-    free(a[0]);
-    free(a);
+    h[0]=alloc2D((size_t)X*Y*sizeof(float),&mapped);
+    h[1]=(float *)(uintptr_t)mapped;
+    for (i=0;i<X;i++)
+        h[i+2]=h[0]+(size_t)i*Y;
+    return h+2;
 }
 
-void init2D(double ** a, int X, int Y) {
+void free2Df(float ** a, int X, int Y) {
+    float ** h=a-2;
+    if ((uintptr_t)h[1]>0)
+        munmap(h[0],(uintptr_t)h[1]);
+    else
+        free(h[0]);
+    free(h);
+}
+
+void copy2D(double ** dst, double ** src, int X, int Y) {
+    int i;
+    for (i=0;i<X;i++)
+        memcpy(dst[i],src[i],Y*sizeof(double));
+}
+
+//1 if a equals its transpose up to rounding
+int symmetric2D(double ** a, int X) {
     int i,j;
     for (i=0;i<X;i++)
-        for (j=0;j<Y;j++)
-            a[i][j]=(rand()%100000)/10000.0;
+        for (j=0;j<i;j++)
+            if (fabs(a[i][j]-a[j][i])>1e-12*(fabs(a[i][j])+fabs(a[j][i])))
+                return 0;
+    return 1;
 }
 
 void print2D(double ** a, int X, int Y) {
@@ -70,4 +176,652 @@ void print2DFile(double **a, int X, int Y, char * filename) {
         fprintf(f,"\n");
     }
     fclose(f);
-}   
+}
+
+//Integer from the environment, def if the variable is not set
+int env_int(char * name, int def) {
+    char * value=getenv(name);
+    if (value==NULL)
+        return def;
+    return atoi(value);
+}
+
+//Benchmark mode, enabled by any of the environment variables WARMUP
+//(untimed runs, default 0), REPS (timed runs, default 1) and BENCH_OUT
+//(file the records are appended to, default bench.csv)
+void bench_init(bench_t * b) {
+    b->enabled=getenv("WARMUP")!=NULL || getenv("REPS")!=NULL || getenv("BENCH_OUT")!=NULL;
+    b->warmup=env_int("WARMUP",0);
+    b->reps=env_int("REPS",1);
+    if (b->warmup<0 || !b->enabled)
+        b->warmup=0;
+    if (b->reps<1 || !b->enabled)
+        b->reps=1;
+    b->times=calloc(b->reps,sizeof(double));
+    if (b->times==NULL) {
+        fprintf(stderr,"Malloc failed!\n");
+        exit(-1);
+    }
+}
+
+int bench_runs(bench_t * b) {
+    return b->warmup+b->reps;
+}
+
+//Time of run number run, warmup runs are dropped
+void bench_time(bench_t * b, int run, double t) {
+    if (run>=b->warmup)
+        b->times[run-b->warmup]=t;
+}
+
+static int cmp_double(const void * a, const void * b) {
+    double x=*(const double *)a,y=*(const double *)b;
+    return (x>y)-(x<y);
+}
+
+//Print min, median and standard deviation of the timed runs and the
+//GFLOP/s of the fastest one (2N^3/3 flops), then append the record to
+//BENCH_OUT, as CSV or as a JSON line if the name ends in .json
+void bench_report(bench_t * b, char * variant, int N, int procs, int threads) {
+    bench_report_flops(b,variant,N,procs,threads,2.0*N*N*N/3.0);
+}
+
+//Same for programs whose flop count is not the one of a dense N x N LU
+void bench_report_flops(bench_t * b, char * variant, int N, int procs, int threads, double flops) {
+    int i,n=b->reps,json;
+    double min,median,mean=0,var=0,gflops;
+    double * t;
+    char * out;
+    FILE * f;
+    if (!b->enabled)
+        return;
+    t=malloc(n*sizeof(double));
+    memcpy(t,b->times,n*sizeof(double));
+    qsort(t,n,sizeof(double),cmp_double);
+    min=t[0];
+    median=(n%2) ? t[n/2] : (t[n/2-1]+t[n/2])/2;
+    for (i=0;i<n;i++)
+        mean+=t[i]/n;
+    for (i=0;i<n;i++)
+        var+=(t[i]-mean)*(t[i]-mean);
+    if (n>1)
+        var/=n-1;
+    gflops=min>0 ? flops/min*1e-9 : 0;
+    free(t);
+    printf("Benchmark\t%s\tWarmup\t%d\tReps\t%d\tMin\t%lf\tMedian\t%lf\tStddev\t%lf\tGFLOP/s\t%.2lf\n",
+            variant,b->warmup,n,min,median,sqrt(var),gflops);
+
+    out=getenv("BENCH_OUT");
+    if (out==NULL)
+        out="bench.csv";
+    f=fopen(out,"a");
+    if (f==NULL) {
+        fprintf(stderr,"Cannot open %s!\n",out);
+        return;
+    }
+    json=strlen(out)>5 && strcmp(out+strlen(out)-5,".json")==0;
+    if (json)
+        fprintf(f,"{\"variant\":\"%s\",\"size\":%d,\"procs\":%d,\"threads\":%d,\"warmup\":%d,\"reps\":%d,"
+                "\"min\":%lf,\"median\":%lf,\"stddev\":%lf,\"gflops\":%.2lf}\n",
+                variant,N,procs,threads,b->warmup,n,min,median,sqrt(var),gflops);
+    else {
+        fseek(f,0,SEEK_END);
+        if (ftell(f)==0)
+            fprintf(f,"variant,size,procs,threads,warmup,reps,min,median,stddev,gflops\n");
+        fprintf(f,"%s,%d,%d,%d,%d,%d,%lf,%lf,%lf,%.2lf\n",variant,N,procs,threads,b->warmup,n,min,median,sqrt(var),gflops);
+    }
+    fclose(f);
+}
+
+//Row update kernels a[j]-=l*b[j] for j in [0,n). The vector versions peel
+//scalar iterations until a is aligned, so any start column works, and load
+//b unaligned since rows of different lengths do not share an alignment.
+static void axpy_scalar(double * a, const double * b, double l, int n) {
+    int j;
+    for (j=0;j<n;j++)
+        a[j]-=l*b[j];
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("sse2")))
+static void axpy_sse2(double * a, const double * b, double l, int n) {
+    int j=0;
+    __m128d vl=_mm_set1_pd(l);
+    for (;j<n && ((uintptr_t)&a[j]&15);j++)
+        a[j]-=l*b[j];
+    for (;j+4<=n;j+=4) {
+        _mm_store_pd(&a[j],_mm_sub_pd(_mm_load_pd(&a[j]),_mm_mul_pd(vl,_mm_loadu_pd(&b[j]))));
+        _mm_store_pd(&a[j+2],_mm_sub_pd(_mm_load_pd(&a[j+2]),_mm_mul_pd(vl,_mm_loadu_pd(&b[j+2]))));
+    }
+    for (;j<n;j++)
+        a[j]-=l*b[j];
+}
+
+__attribute__((target("avx2,fma")))
+static void axpy_avx2(double * a, const double * b, double l, int n) {
+    int j=0;
+    __m256d vl=_mm256_set1_pd(l);
+    for (;j<n && ((uintptr_t)&a[j]&31);j++)
+        a[j]-=l*b[j];
+    for (;j+8<=n;j+=8) {
+        _mm256_store_pd(&a[j],_mm256_fnmadd_pd(vl,_mm256_loadu_pd(&b[j]),_mm256_load_pd(&a[j])));
+        _mm256_store_pd(&a[j+4],_mm256_fnmadd_pd(vl,_mm256_loadu_pd(&b[j+4]),_mm256_load_pd(&a[j+4])));
+    }
+    for (;j+4<=n;j+=4)
+        _mm256_store_pd(&a[j],_mm256_fnmadd_pd(vl,_mm256_loadu_pd(&b[j]),_mm256_load_pd(&a[j])));
+    for (;j<n;j++)
+        a[j]-=l*b[j];
+}
+
+//The head up to the first 64-byte boundary and the tail are masked
+__attribute__((target("avx512f")))
+static void axpy_avx512(double * a, const double * b, double l, int n) {
+    int j=0,h;
+    __m512d vl=_mm512_set1_pd(l);
+    __mmask8 m;
+    h=((64-((uintptr_t)a&63))&63)/8;
+    if (h>n)
+        h=n;
+    if (h>0) {
+        m=(1<<h)-1;
+        _mm512_mask_storeu_pd(a,m,_mm512_fnmadd_pd(vl,_mm512_maskz_loadu_pd(m,b),_mm512_maskz_loadu_pd(m,a)));
+        j=h;
+    }
+    for (;j+16<=n;j+=16) {
+        _mm512_store_pd(&a[j],_mm512_fnmadd_pd(vl,_mm512_loadu_pd(&b[j]),_mm512_load_pd(&a[j])));
+        _mm512_store_pd(&a[j+8],_mm512_fnmadd_pd(vl,_mm512_loadu_pd(&b[j+8]),_mm512_load_pd(&a[j+8])));
+    }
+    for (;j+8<=n;j+=8)
+        _mm512_store_pd(&a[j],_mm512_fnmadd_pd(vl,_mm512_loadu_pd(&b[j]),_mm512_load_pd(&a[j])));
+    if (j<n) {
+        m=(1<<(n-j))-1;
+        _mm512_mask_storeu_pd(&a[j],m,_mm512_fnmadd_pd(vl,_mm512_maskz_loadu_pd(m,&b[j]),_mm512_maskz_loadu_pd(m,&a[j])));
+    }
+}
+#endif
+
+//Single precision versions, twice the elements per vector
+static void axpyf_scalar(float * a, const float * b, float l, int n) {
+    int j;
+    for (j=0;j<n;j++)
+        a[j]-=l*b[j];
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("sse2")))
+static void axpyf_sse2(float * a, const float * b, float l, int n) {
+    int j=0;
+    __m128 vl=_mm_set1_ps(l);
+    for (;j<n && ((uintptr_t)&a[j]&15);j++)
+        a[j]-=l*b[j];
+    for (;j+8<=n;j+=8) {
+        _mm_store_ps(&a[j],_mm_sub_ps(_mm_load_ps(&a[j]),_mm_mul_ps(vl,_mm_loadu_ps(&b[j]))));
+        _mm_store_ps(&a[j+4],_mm_sub_ps(_mm_load_ps(&a[j+4]),_mm_mul_ps(vl,_mm_loadu_ps(&b[j+4]))));
+    }
+    for (;j<n;j++)
+        a[j]-=l*b[j];
+}
+
+__attribute__((target("avx2,fma")))
+static void axpyf_avx2(float * a, const float * b, float l, int n) {
+    int j=0;
+    __m256 vl=_mm256_set1_ps(l);
+    for (;j<n && ((uintptr_t)&a[j]&31);j++)
+        a[j]-=l*b[j];
+    for (;j+16<=n;j+=16) {
+        _mm256_store_ps(&a[j],_mm256_fnmadd_ps(vl,_mm256_loadu_ps(&b[j]),_mm256_load_ps(&a[j])));
+        _mm256_store_ps(&a[j+8],_mm256_fnmadd_ps(vl,_mm256_loadu_ps(&b[j+8]),_mm256_load_ps(&a[j+8])));
+    }
+    for (;j+8<=n;j+=8)
+        _mm256_store_ps(&a[j],_mm256_fnmadd_ps(vl,_mm256_loadu_ps(&b[j]),_mm256_load_ps(&a[j])));
+    for (;j<n;j++)
+        a[j]-=l*b[j];
+}
+
+__attribute__((target("avx512f")))
+static void axpyf_avx512(float * a, const float * b, float l, int n) {
+    int j=0,h;
+    __m512 vl=_mm512_set1_ps(l);
+    __mmask16 m;
+    h=((64-((uintptr_t)a&63))&63)/4;
+    if (h>n)
+        h=n;
+    if (h>0) {
+        m=(1<<h)-1;
+        _mm512_mask_storeu_ps(a,m,_mm512_fnmadd_ps(vl,_mm512_maskz_loadu_ps(m,b),_mm512_maskz_loadu_ps(m,a)));
+        j=h;
+    }
+    for (;j+32<=n;j+=32) {
+        _mm512_store_ps(&a[j],_mm512_fnmadd_ps(vl,_mm512_loadu_ps(&b[j]),_mm512_load_ps(&a[j])));
+        _mm512_store_ps(&a[j+16],_mm512_fnmadd_ps(vl,_mm512_loadu_ps(&b[j+16]),_mm512_load_ps(&a[j+16])));
+    }
+    for (;j+16<=n;j+=16)
+        _mm512_store_ps(&a[j],_mm512_fnmadd_ps(vl,_mm512_loadu_ps(&b[j]),_mm512_load_ps(&a[j])));
+    if (j<n) {
+        m=(1<<(n-j))-1;
+        _mm512_mask_storeu_ps(&a[j],m,_mm512_fnmadd_ps(vl,_mm512_maskz_loadu_ps(m,&b[j]),_mm512_maskz_loadu_ps(m,&a[j])));
+    }
+}
+#endif
+
+static void (*axpy_kernel)(double *, const double *, double, int)=axpy_scalar;
+static void (*axpyf_kernel)(float *, const float *, float, int)=axpyf_scalar;
+static int simd=SIMD_SCALAR;
+
+//Pick the widest kernel the CPU supports once at startup, the environment
+//variable SIMD=scalar|sse2|avx2|avx512 can ask for a narrower one
+__attribute__((constructor))
+static void init_kernels(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    char * cap=getenv("SIMD");
+    int level=3;
+    if (cap!=NULL) {
+        if (strcmp(cap,"scalar")==0)
+            level=0;
+        else if (strcmp(cap,"sse2")==0)
+            level=1;
+        else if (strcmp(cap,"avx2")==0)
+            level=2;
+    }
+    __builtin_cpu_init();
+    if (level>=3 && __builtin_cpu_supports("avx512f")) {
+        axpy_kernel=axpy_avx512;
+        axpyf_kernel=axpyf_avx512;
+        simd=SIMD_AVX512;
+    }
+    else if (level>=2 && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        axpy_kernel=axpy_avx2;
+        axpyf_kernel=axpyf_avx2;
+        simd=SIMD_AVX2;
+    }
+    else if (level>=1 && __builtin_cpu_supports("sse2")) {
+        axpy_kernel=axpy_sse2;
+        axpyf_kernel=axpyf_sse2;
+        simd=SIMD_SSE2;
+    }
+#endif
+}
+
+//Instruction set of the selected kernels, for modules with their own
+int simd_level(void) {
+    return simd;
+}
+
+void axpy_row(double * a, const double * b, double l, int n) {
+    axpy_kernel(a,b,l,n);
+}
+
+//Eliminate column k of row a with the pivot row p: the multiplier is kept
+//in a[k] and columns (k,n) are updated. Returns the multiplier.
+double eliminate_row(double * a, const double * p, int k, int n) {
+    double l=a[k]/p[k];
+    a[k]=l;
+    axpy_kernel(&a[k+1],&p[k+1],l,n-k-1);
+    return l;
+}
+
+void axpy_rowf(float * a, const float * b, float l, int n) {
+    axpyf_kernel(a,b,l,n);
+}
+
+float eliminate_rowf(float * a, const float * p, int k, int n) {
+    float l=a[k]/p[k];
+    a[k]=l;
+    axpyf_kernel(&a[k+1],&p[k+1],l,n-k-1);
+    return l;
+}
+
+//Solve LU*X=B for columns [c0,c1) of the N x nrhs matrix B, X overwrites B.
+//LU holds the unit lower factor below the diagonal and U on and above it.
+//Rows are processed in blocks of SOLVE_NB, the rows below (above) a block
+//are updated with all of its rows at once, as a matrix-matrix product.
+void solve2D(double ** LU, int N, double ** B, int c0, int c1) {
+    int i,j,p,kb,kend;
+    double l;
+
+    //Forward substitution L*Z=B
+    for (kb=0;kb<N;kb+=SOLVE_NB) {
+        kend=MIN(kb+SOLVE_NB,N);
+        for (i=kb+1;i<kend;i++)
+            for (p=kb;p<i;p++) {
+                l=LU[i][p];
+                for (j=c0;j<c1;j++)
+                    B[i][j]-=l*B[p][j];
+            }
+        for (i=kend;i<N;i++)
+            for (p=kb;p<kend;p++) {
+                l=LU[i][p];
+                for (j=c0;j<c1;j++)
+                    B[i][j]-=l*B[p][j];
+            }
+    }
+
+    //Back substitution U*X=Z
+    for (kend=N;kend>0;kend-=SOLVE_NB) {
+        kb=kend-SOLVE_NB>0 ? kend-SOLVE_NB : 0;
+        for (i=kend-1;i>=kb;i--) {
+            for (p=i+1;p<kend;p++) {
+                l=LU[i][p];
+                for (j=c0;j<c1;j++)
+                    B[i][j]-=l*B[p][j];
+            }
+            l=1.0/LU[i][i];
+            for (j=c0;j<c1;j++)
+                B[i][j]*=l;
+        }
+        for (i=0;i<kb;i++)
+            for (p=kb;p<kend;p++) {
+                l=LU[i][p];
+                for (j=c0;j<c1;j++)
+                    B[i][j]-=l*B[p][j];
+            }
+    }
+}
+
+//Solve U^T*U*X=B for columns [c0,c1) of B with the Cholesky factor U on and
+//above the diagonal, X overwrites B. Both substitutions read U by rows.
+void solve_chol2D(double ** U, int N, double ** B, int c0, int c1) {
+    int i,j,p;
+    double l;
+
+    //U^T*Z=B, every solved row of Z updates the rows below it
+    for (p=0;p<N;p++) {
+        l=1.0/U[p][p];
+        for (j=c0;j<c1;j++)
+            B[p][j]*=l;
+        for (i=p+1;i<N;i++) {
+            l=U[p][i];
+            for (j=c0;j<c1;j++)
+                B[i][j]-=l*B[p][j];
+        }
+    }
+
+    //U*X=Z
+    for (i=N-1;i>=0;i--) {
+        for (p=i+1;p<N;p++) {
+            l=U[i][p];
+            for (j=c0;j<c1;j++)
+                B[i][j]-=l*B[p][j];
+        }
+        l=1.0/U[i][i];
+        for (j=c0;j<c1;j++)
+            B[i][j]*=l;
+    }
+}
+
+//Scaled residual max|A*X-B| / (max|A| * max|X| * N)
+double residual2D(double ** A, double ** X, double ** B, int N, int nrhs) {
+    int i,j,p;
+    double r,rmax=0,amax=0,xmax=0;
+    double * row=malloc(nrhs*sizeof(double));
+    if (row==NULL) {
+        fprintf(stderr,"Malloc failed!\n");
+        exit(-1);
+    }
+    for (i=0;i<N;i++) {
+        for (j=0;j<nrhs;j++)
+            row[j]=-B[i][j];
+        for (p=0;p<N;p++) {
+            if (fabs(A[i][p])>amax)
+                amax=fabs(A[i][p]);
+            for (j=0;j<nrhs;j++)
+                row[j]+=A[i][p]*X[p][j];
+        }
+        for (j=0;j<nrhs;j++) {
+            r=fabs(row[j]);
+            if (r>rmax)
+                rmax=r;
+            if (fabs(X[i][j])>xmax)
+                xmax=fabs(X[i][j]);
+        }
+    }
+    free(row);
+    if (amax==0 || xmax==0)
+        return rmax;
+    return rmax/(amax*xmax*N);
+}
+
+//Scaled residual max|A*v-L*(U*v)|/(max|A|*max|v|*N) of the factors in LU
+//for the original array A and a random probe vector v: two matrix-vector
+//products, where forming L*U would cost as much as the factorization
+double verify2D(double ** A, double ** LU, int N) {
+    int i,j;
+    double s,r,rmax=0,amax=0,vmax=0;
+    double * v=malloc(2*N*sizeof(double)), * w=&v[N];
+    if (v==NULL) {
+        fprintf(stderr,"Malloc failed!\n");
+        exit(-1);
+    }
+    for (j=0;j<N;j++) {
+        v[j]=rand_entry(RAND_PROBE,j,0);
+        if (v[j]>vmax)
+            vmax=v[j];
+    }
+    //w=U*v, then L*w with the unit diagonal of L
+    for (i=0;i<N;i++) {
+        s=0;
+        for (j=i;j<N;j++)
+            s+=LU[i][j]*v[j];
+        w[i]=s;
+    }
+    for (i=0;i<N;i++) {
+        s=w[i];
+        for (j=0;j<i;j++)
+            s+=LU[i][j]*w[j];
+        for (j=0;j<N;j++) {
+            s-=A[i][j]*v[j];
+            if (fabs(A[i][j])>amax)
+                amax=fabs(A[i][j]);
+        }
+        //A NaN from a zero pivot fails the check
+        r=fabs(s);
+        if (!(r<=rmax))
+            rmax=isnan(r) ? HUGE_VAL : r;
+    }
+    free(v);
+    if (amax==0 || vmax==0)
+        return rmax;
+    return rmax/(amax*vmax*N);
+}
+
+//One line with the verification result, PASSED below VERIFY_TOL
+void verify_report(char * variant, double residual, double time) {
+    printf("%s-Verify\tResidual\t%e\t%s\tTime\t%.3lf\n",variant,residual,residual<VERIFY_TOL ? "PASSED" : "FAILED",time);
+}
+
+//Output mode from the environment: OUTPUT=text, OUTPUT=binary or nothing
+int output_mode(void) {
+    char * value=getenv("OUTPUT");
+    if (value==NULL)
+        return OUT_NONE;
+    if (strcmp(value,"text")==0)
+        return OUT_TEXT;
+    if (strcmp(value,"binary")==0)
+        return OUT_BINARY;
+    return OUT_NONE;
+}
+
+//Write the final array in the requested output mode, binary files get .bin
+void output2D(double ** a, int X, int Y, char * filename) {
+    char * binname;
+    switch (output_mode()) {
+        case OUT_TEXT:
+            print2DFile(a,X,Y,filename);
+            break;
+        case OUT_BINARY:
+            binname=malloc(strlen(filename)+5);
+            sprintf(binname,"%s.bin",filename);
+            write2DBinary(a,X,Y,binname);
+            free(binname);
+            break;
+    }
+}
+
+//Header of a row-major X x Y double matrix file
+void init2DHeader(mat_header * h, int X, int Y) {
+    memset(h,0,sizeof(*h));
+    memcpy(h->magic,MAT_MAGIC,4);
+    h->dtype=sizeof(double);
+    h->layout=LAYOUT_ROW_MAJOR;
+    h->rows=X;
+    h->cols=Y;
+}
+
+void write2DBinary(double ** a, int X, int Y, char * filename) {
+    int i;
+    mat_header h;
+    FILE * f=fopen(filename,"wb");
+    if (f==NULL) {
+        fprintf(stderr,"Cannot open %s!\n",filename);
+        exit(-1);
+    }
+    init2DHeader(&h,X,Y);
+    fwrite(&h,sizeof(h),1,f);
+    for (i=0;i<X;i++)
+        fwrite(a[i],sizeof(double),Y,f);
+    fclose(f);
+}
+
+//Map a binary matrix file, checks the header and returns the mapping
+static mat_header * map2DBinary(char * filename, size_t * length) {
+    int fd;
+    struct stat st;
+    mat_header * h;
+    fd=open(filename,O_RDONLY);
+    if (fd<0 || fstat(fd,&st)<0 || st.st_size<(off_t)sizeof(mat_header)) {
+        fprintf(stderr,"Cannot read %s!\n",filename);
+        exit(-1);
+    }
+    h=mmap(NULL,st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+    close(fd);
+    if (h==MAP_FAILED) {
+        fprintf(stderr,"Cannot map %s!\n",filename);
+        exit(-1);
+    }
+    if (memcmp(h->magic,MAT_MAGIC,4)!=0 || h->dtype!=sizeof(double) || h->layout!=LAYOUT_ROW_MAJOR
+            || (off_t)(sizeof(mat_header)+h->rows*h->cols*sizeof(double))>st.st_size) {
+        fprintf(stderr,"%s is not a row-major double matrix file!\n",filename);
+        exit(-1);
+    }
+    *length=st.st_size;
+    return h;
+}
+
+void read2DHeader(char * filename, int * X, int * Y) {
+    size_t length;
+    mat_header * h=map2DBinary(filename,&length);
+    *X=h->rows;
+    *Y=h->cols;
+    munmap(h,length);
+}
+
+//Copy rows [row0,row0+X) of a binary matrix file with Y columns into a
+void load2DBinary(double ** a, int row0, int X, int Y, char * filename) {
+    int i;
+    size_t length;
+    mat_header * h=map2DBinary(filename,&length);
+    double * data=(double *)(h+1);
+    if (h->cols!=Y || row0+X>h->rows) {
+        fprintf(stderr,"%s does not have the expected size!\n",filename);
+        exit(-1);
+    }
+    madvise(h,length,MADV_SEQUENTIAL);
+    for (i=0;i<X;i++)
+        memcpy(a[i],&data[(size_t)(row0+i)*Y],Y*sizeof(double));
+    munmap(h,length);
+}
+
+//The first argument of the programs is either the size of a random
+//array or a binary matrix file
+static int is_number(char * arg) {
+    return arg[0]!='\0' && strspn(arg,"0123456789")==strlen(arg);
+}
+
+int input_is_file(char * arg) {
+    return !is_number(arg);
+}
+
+int input_size(char * arg) {
+    int X,Y;
+    if (is_number(arg))
+        return atoi(arg);
+    read2DHeader(arg,&X,&Y);
+    if (X!=Y) {
+        fprintf(stderr,"%s is not a square matrix!\n",arg);
+        exit(-1);
+    }
+    return X;
+}
+
+//The functions below have openMP loops, utils_omp.o is the build of this file
+//that the openMP programs link
+
+//First touch of the rows with schedule(static,TOUCH_CHUNK): row i lands in
+//the memory of thread (i/TOUCH_CHUNK)%threads, the thread that updates it
+//in the loops that start at touch_start
+void touch2D(double ** a, int X, int Y) {
+    int i;
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(static,TOUCH_CHUNK)
+#endif
+    for (i=0;i<X;i++)
+        memset(a[i],0,Y*sizeof(double));
+}
+
+//First index of a schedule(static,TOUCH_CHUNK) loop over rows [lo,X) that
+//deals the rows as touch2D did, the loop skips the rows below lo
+int touch_start(int lo, int threads) {
+    return lo-lo%(TOUCH_CHUNK*threads);
+}
+
+//Row g of a random matrix of the given kind with Y columns. RAND_SPD is
+//symmetric with a dominant positive diagonal, which makes it positive
+//definite; the diagonal is summed in column order in every row.
+void rand_row(double * row, uint64_t g, int Y, int kind) {
+    int j;
+    double sum=1.0;
+    if (kind!=RAND_SPD) {
+        for (j=0;j<Y;j++)
+            row[j]=rand_entry(kind,g,j);
+        return;
+    }
+    for (j=0;j<Y;j++)
+        if (j!=(int)g) {
+            row[j]=j<(int)g ? rand_entry(RAND_MATRIX,g,j) : rand_entry(RAND_MATRIX,j,g);
+            sum+=row[j];
+        }
+    row[g]=sum;
+}
+
+//n rows where a[i] is row g0+i*stride, with the schedule of touch2D in the
+//openMP builds (utils_omp.o)
+void rand_rows(double ** a, int n, long g0, long stride, int Y, int kind) {
+    int i;
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(static,TOUCH_CHUNK)
+#endif
+    for (i=0;i<n;i++)
+        rand_row(a[i],g0+i*stride,Y,kind);
+}
+
+void init2D(double ** a, int X, int Y) {
+    rand_rows(a,X,0,1,Y,RAND_MATRIX);
+}
+
+//Random right-hand sides, independent of the matrix
+void init2DRHS(double ** a, int X, int Y) {
+    rand_rows(a,X,0,1,Y,RAND_RHS);
+}
+
+void init2DSPD(double ** a, int X) {
+    rand_rows(a,X,0,1,X,RAND_SPD);
+}
+
+//The first program argument is the size of a random array or a binary
+//matrix file
+void input2D(double ** a, int X, int Y, char * arg) {
+    if (input_is_file(arg))
+        load2DBinary(a,0,X,Y,arg);
+    else
+        init2D(a,X,Y);
+}
@@ -12,9 +12,111 @@
 # along with this program. If not, see <http://www.gnu.org/licenses/>.
 # **************************************************/
 
+#ifndef UTILS_H__
+#define UTILS_H__
+
+#include <stdint.h>
+#include <string.h>
+
+//Binary matrix files: this header followed by the elements
+#define MAT_MAGIC "LUMX"
+#define LAYOUT_ROW_MAJOR 0
+
+typedef struct {
+    char magic[4];
+    int32_t dtype;          //bytes per element, 8 for double
+    int32_t layout;         //LAYOUT_ROW_MAJOR
+    int32_t reserved;
+    int64_t rows;
+    int64_t cols;
+} mat_header;
+
+//Output modes selected with the OUTPUT environment variable
+#define OUT_NONE 0
+#define OUT_TEXT 1
+#define OUT_BINARY 2
+
+//Benchmark mode: warmup runs and timed repetitions of the factorization
+typedef struct {
+    int enabled;
+    int warmup;
+    int reps;
+    double * times;
+} bench_t;
+
+//Row kernel instruction sets, SIMD=scalar|sse2|avx2|avx512
+#define SIMD_SCALAR 0
+#define SIMD_SSE2 1
+#define SIMD_AVX2 2
+#define SIMD_AVX512 3
+
 double ** malloc2D(int X, int Y);
+double ** malloc2DPadded(int X, int Y);
 void free2D(double ** a, int X, int Y);
-void init2D(double **a, int X, int Y);
+float ** malloc2Df(int X, int Y);
+void free2Df(float ** a, int X, int Y);
+void copy2D(double ** dst, double ** src, int X, int Y);
+int symmetric2D(double ** a, int X);
 void print2D(double **a, int X, int Y);
 void print2DFile(double **a, int X, int Y, char * filename);
+int env_int(char * name, int def);
+void bench_init(bench_t * b);
+int bench_runs(bench_t * b);
+void bench_time(bench_t * b, int run, double t);
+void bench_report(bench_t * b, char * variant, int N, int procs, int threads);
+void bench_report_flops(bench_t * b, char * variant, int N, int procs, int threads, double flops);
+int simd_level(void);
+void axpy_row(double * a, const double * b, double l, int n);
+double eliminate_row(double * a, const double * p, int k, int n);
+void axpy_rowf(float * a, const float * b, float l, int n);
+float eliminate_rowf(float * a, const float * p, int k, int n);
+void solve2D(double ** LU, int N, double ** B, int c0, int c1);
+void solve_chol2D(double ** U, int N, double ** B, int c0, int c1);
+double residual2D(double ** A, double ** X, double ** B, int N, int nrhs);
+double verify2D(double ** A, double ** LU, int N);
+void verify_report(char * variant, double residual, double time);
+int output_mode(void);
+void output2D(double ** a, int X, int Y, char * filename);
+void init2DHeader(mat_header * h, int X, int Y);
+void write2DBinary(double ** a, int X, int Y, char * filename);
+void read2DHeader(char * filename, int * X, int * Y);
+void load2DBinary(double ** a, int row0, int X, int Y, char * filename);
+int input_is_file(char * arg);
+int input_size(char * arg);
+
+//VERIFY=1 checks the factors, a larger scaled residual fails
+#define VERIFY_TOL 1e-9
+
+//Rows per chunk of the openMP row loops that keep every row on one thread
+#define TOUCH_CHUNK 8
+
+//Random inputs come from a counter-based generator: entry (i,j) of a
+//stream is a SplitMix64 hash of the stream and the two indices, so any
+//process or thread can make any row on its own and the matrix does not
+//depend on how many of them there are
+#define RAND_MATRIX 1
+#define RAND_RHS 2
+#define RAND_SPD 3
+#define RAND_PROBE 4
+
+static inline uint64_t splitmix64(uint64_t z) {
+    z=(z^(z>>30))*0xbf58476d1ce4e5b9ULL;
+    z=(z^(z>>27))*0x94d049bb133111ebULL;
+    return z^(z>>31);
+}
+
+//0 to 9.9999 in steps of 0.0001, the values rand()%100000/10000.0 gave
+static inline double rand_entry(uint64_t seed, uint64_t i, uint64_t j) {
+    return (splitmix64(seed*0xd1b54a32d192ed03ULL+((i<<32)|j)*0x9e3779b97f4a7c15ULL)%100000)/10000.0;
+}
+
+void touch2D(double ** a, int X, int Y);
+int touch_start(int lo, int threads);
+void rand_row(double * row, uint64_t g, int Y, int kind);
+void rand_rows(double ** a, int n, long g0, long stride, int Y, int kind);
+void init2D(double ** a, int X, int Y);
+void init2DRHS(double ** a, int X, int Y);
+void init2DSPD(double ** a, int X);
+void input2D(double ** a, int X, int Y, char * arg);
 
+#endif  /* UTILS_H__ */